@@ -18,20 +18,1695 @@
 #include "riscv_isa_init.cpp"
 #include "riscv_bhv_macros.H"
 #include <fenv.h>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <smmintrin.h>
+#endif
+#include "riscv_clock.H"
+#include "riscv_csr.H"
+#include "riscv_forkserver.H"
+#include "riscv_hle.H"
+#include "riscv_fdlibm.H"
+#include "riscv_layout.H"
+#include "riscv_rvc.H"
+#include "riscv_rvv.H"
+#include "riscv_shm.H"
+#include "riscv_softfloat.H"
+#include "riscv_syscall.H"
 
 // Uncomment for debug Information
 //#define DEBUG_MODEL
 #include "ac_debug_model.H"
 
+// Zicbom/Zicboz cache-block size, bytes
+#define RISCV_CBO_SIZE 64
+
+// Uncomment to model MESI coherence between the harts' private L1s
+//#define RISCV_COHERENCE
+
+#ifdef RISCV_COHERENCE
+#include "riscv_coherence.H"
+#define COHERENCE_READ(addr, size) \
+  riscv_coherence::instance().read(hartid, addr, size)
+#define COHERENCE_WRITE(addr, size) \
+  riscv_coherence::instance().write(hartid, addr, size)
+#define COHERENCE_CBO(addr, writeback, invalidate) \
+  riscv_coherence::instance().cbo(addr, RISCV_CBO_SIZE, writeback, invalidate)
+#else
+#define COHERENCE_READ(addr, size)
+#define COHERENCE_WRITE(addr, size)
+#define COHERENCE_CBO(addr, writeback, invalidate)
+#endif
+
+// Comment out to compile the hardware performance monitor events out;
+// mhpmcounter3-31 then only hold the values written to them
+#define RISCV_HPM
+
+#ifdef RISCV_HPM
+#define HPM_COUNT(event)                                                  \
+  do {                                                                    \
+    if (__builtin_expect((hpm_mask >> (event)) & 1, 0))                   \
+      hpm_count[event]++;                                                 \
+  } while (0)
+#else
+#define HPM_COUNT(event)
+#endif
+
+// Comment out to stop parking harts that spin-wait or execute WFI
+#define RISCV_IDLE
+
+#ifdef RISCV_IDLE
+#include "riscv_idle.H"
+// Parked harts skip at most up to `deadline`, the next interrupt
+#define IDLE_BUDGET(deadline)                                             \
+  std::min<uint64_t>(riscv_idle::instance().budget(),                     \
+                     (deadline) > cycles() ? (deadline) - cycles() : 0)
+#define IDLE_LOAD(addr)                                                   \
+  do {                                                                    \
+    spin_load = (addr);                                                   \
+    spin_loaded = true;                                                   \
+  } while (0)
+#define IDLE_STORE(addr)                                                  \
+  do {                                                                    \
+    store_count++;                                                        \
+    if (riscv_idle::instance().watching())                                \
+      riscv_idle::instance().store(addr);                                 \
+  } while (0)
+#define IDLE_BRANCH(target)                                               \
+  do {                                                                    \
+    if ((ac_word)(target) < ac_pc && ac_pc - (target) <= 64 &&            \
+        spin_check(target))                                               \
+      idle_skipped += riscv_idle::instance().park(                        \
+          hartid, true, spin_load, IDLE_BUDGET(irq_at),                   \
+          processors_started);                                            \
+  } while (0)
+#else
+#define IDLE_LOAD(addr)
+#define IDLE_STORE(addr)
+#define IDLE_BRANCH(target)
+#endif
+
+// Uncomment to count flops and FP load/store bytes per function and
+// print a roofline report at the end (see riscv_fpprof.H)
+//#define RISCV_FP_PROFILE
+
+#ifdef RISCV_FP_PROFILE
+#include "riscv_fpprof.H"
+#define FP_PROFILE_COUNT(flops, bytes) \
+  riscv_fpprof::instance().count((ac_word)ac_pc - 4, flops, bytes)
+#else
+#define FP_PROFILE_COUNT(flops, bytes)
+#endif
+
+// Run first by every FP load, store and arithmetic behavior; the ones
+// with flops are the FP operations of the performance monitor
+#define FP_PROFILE(flops, bytes)                                          \
+  do {                                                                    \
+    if (flops)                                                            \
+      HPM_COUNT(HPM_FP_OPS);                                              \
+    FP_PROFILE_COUNT(flops, bytes);                                       \
+  } while (0)
+
+// Accesses to the guard area below the hart's stack are access faults
+// (see stack_fault()); the behavior returns before touching memory
+#define GUARD_HIT(addr) ((ac_word)(addr) - guard_lo < guard_size)
+#define STACK_GUARD(addr, cause)                                          \
+  do {                                                                    \
+    if (GUARD_HIT(addr)) {                                                \
+      stack_fault(addr, cause);                                           \
+      return;                                                             \
+    }                                                                     \
+  } while (0)
+
+// A store that overlaps the reserved doubleword ends the hart's LR
+// reservation, so a later SC to it fails
+#define RESERVATION_CLEAR(addr, size)                                     \
+  do {                                                                    \
+    if (lr_valid && (ac_word)(addr) < (lr_addr & ~(ac_word)7) + 8 &&      \
+        (ac_word)(addr) + (size) > (lr_addr & ~(ac_word)7))               \
+      lr_valid = false;                                                   \
+  } while (0)
+
+// Hooks run by every load and store behavior; the *_COUNT parts are
+// for callers that checked the guard area themselves (hle_string)
+#define MEM_READ_COUNT(addr, size)                                        \
+  do {                                                                    \
+    HPM_COUNT(HPM_LOADS);                                                 \
+    COHERENCE_READ(addr, size);                                           \
+    IDLE_LOAD(addr);                                                      \
+  } while (0)
+#define MEM_WRITE_COUNT(addr, size)                                       \
+  do {                                                                    \
+    HPM_COUNT(HPM_STORES);                                                \
+    RESERVATION_CLEAR(addr, size);                                        \
+    COHERENCE_WRITE(addr, size);                                          \
+    IDLE_STORE(addr);                                                     \
+  } while (0)
+#define MEM_READ_HOOK(addr, size)                                         \
+  do {                                                                    \
+    STACK_GUARD(addr, RISCV_CAUSE_LOAD_ACCESS);                           \
+    MEM_READ_COUNT(addr, size);                                           \
+  } while (0)
+#define MEM_WRITE_HOOK(addr, size)                                        \
+  do {                                                                    \
+    STACK_GUARD(addr, RISCV_CAUSE_STORE_ACCESS);                          \
+    MEM_WRITE_COUNT(addr, size);                                          \
+  } while (0)
+
+// Misaligned loads, stores and AMOs trap once the guest installed a
+// handler (see trap()); without one they are performed as before
+#define MEM_ALIGN(addr, size, cause)                                      \
+  do {                                                                    \
+    if (((addr) & ((size) - 1)) && trap(cause, addr))                     \
+      return;                                                             \
+  } while (0)
+#define LOAD_ALIGN(addr, size) \
+  MEM_ALIGN(addr, size, RISCV_CAUSE_LOAD_MISALIGNED)
+#define STORE_ALIGN(addr, size) \
+  MEM_ALIGN(addr, size, RISCV_CAUSE_STORE_MISALIGNED)
+
+// Block boundaries take a pending interrupt, or one the timer raised
+// since: one compare against the instruction budget left in irq_at.
+// Everything else never looks at interrupts.
+#define IRQ_CHECK()                                                       \
+  do {                                                                    \
+    if (__builtin_expect(cycles() >= irq_at, 0))                          \
+      interrupt();                                                        \
+  } while (0)
+
+// Comment out to drop the CLINT (riscv_clock.H) from the word and
+// doubleword loads and stores; mtime is still the time CSR
+#define RISCV_CLINT
+
+#ifdef RISCV_CLINT
+#define CLINT_HIT(addr) \
+  ((ac_word)(addr) - RISCV_CLINT_BASE < RISCV_CLINT_SIZE)
+#else
+#define CLINT_HIT(addr) false
+#endif
+
+// Loads and stores that fall in the shared window (riscv_shm.H) use the
+// host mapping shared with the other simulator processes
+#define SHM_HIT(addr) ((ac_word)(addr) - shm_base < shm_size)
+#define SHM_PTR(addr) (shm_mem + ((ac_word)(addr) - shm_base))
+#define READ_BYTE(addr)                                                   \
+  (SHM_HIT(addr) ? riscv_shm_load<uint8_t>(SHM_PTR(addr))                 \
+                 : (uint8_t)DM.read_byte(addr))
+#define READ_HALF(addr)                                                   \
+  (SHM_HIT(addr) ? riscv_shm_load<uint16_t>(SHM_PTR(addr))                \
+                 : (uint16_t)DM.read_half(addr))
+// DM.read/DM.write move an ac_word and read_half/write_half half of
+// one: 32 and 16 bits on RV32, 64 and 32 bits on RV64
+#define READ_WORD(addr)                                                   \
+  (SHM_HIT(addr) ? riscv_shm_load<uint32_t>(SHM_PTR(addr))                \
+   : CLINT_HIT(addr) ? (uint32_t)clint_read(addr, 4)                      \
+   : XLEN == 64  ? (uint32_t)DM.read_half(addr)                           \
+                 : (uint32_t)DM.read(addr))
+#define READ_DWORD(addr)                                                  \
+  (SHM_HIT(addr) ? riscv_shm_load<uint64_t>(SHM_PTR(addr))                \
+   : CLINT_HIT(addr) ? clint_read(addr, 8)                                \
+   : XLEN == 64  ? (uint64_t)DM.read(addr)                                \
+                 : (uint64_t)(uint32_t)DM.read(addr) |                    \
+                   (uint64_t)(uint32_t)DM.read((addr) + 4) << 32)
+#define WRITE_BYTE(addr, value)                                           \
+  do {                                                                    \
+    if (SHM_HIT(addr))                                                    \
+      riscv_shm_store<uint8_t>(SHM_PTR(addr), value);                     \
+    else                                                                  \
+      DM.write_byte(addr, value);                                         \
+  } while (0)
+#define WRITE_HALF(addr, value)                                           \
+  do {                                                                    \
+    if (SHM_HIT(addr))                                                    \
+      riscv_shm_store<uint16_t>(SHM_PTR(addr), value);                    \
+    else if (XLEN == 64) {                                                \
+      DM.write_byte(addr, (uint8_t)(value));                              \
+      DM.write_byte((addr) + 1, (uint8_t)((value) >> 8));                 \
+    } else                                                                \
+      DM.write_half(addr, value);                                         \
+  } while (0)
+#define WRITE_WORD(addr, value)                                           \
+  do {                                                                    \
+    if (SHM_HIT(addr))                                                    \
+      riscv_shm_store<uint32_t>(SHM_PTR(addr), value);                    \
+    else if (CLINT_HIT(addr))                                             \
+      clint_write(addr, (uint32_t)(value), 4);                            \
+    else if (XLEN == 64)                                                  \
+      DM.write_half(addr, (uint32_t)(value));                             \
+    else                                                                  \
+      DM.write(addr, value);                                              \
+  } while (0)
+
+// FP backends, selected with RISCV_FP=host|soft|check. The soft
+// backend computes every F/D result with riscv_softfloat.H; check runs
+// the host code and compares its result with the soft one.
+#define FP_HOST  0
+#define FP_SOFT  1
+#define FP_CHECK 2
+
+namespace sf = riscv_sf;
+
+#define FS(r) ((uint64_t)load_float_bits(r))
+#define FD(r) ((uint64_t)RBF[r])
+
+#define SOFT_WRITE_S(r) save_float_bits((uint32_t)(r), rd)
+#define SOFT_WRITE_D(r) RBF[rd] = (r)
+// X is a 32-bit integer result (sign-extended on RV64), L a 64-bit one
+#define SOFT_WRITE_X(r) RB[rd] = (int32_t)(r)
+#define SOFT_WRITE_L(r) RB[rd] = (r)
+#define SOFT_HOST_S ((uint64_t)RBF[rd])
+#define SOFT_HOST_D ((uint64_t)RBF[rd])
+#define SOFT_HOST_X ((uint64_t)(uint32_t)RB[rd])
+#define SOFT_HOST_L ((uint64_t)RB[rd])
+#define SOFT_EXPECT_S(r) (NAN_BOX | (uint32_t)(r))
+#define SOFT_EXPECT_D(r) (r)
+#define SOFT_EXPECT_X(r) ((uint64_t)(uint32_t)(r))
+#define SOFT_EXPECT_L(r) (r)
+
+// Top of an FP behavior: `expr` gives the result bits from riscv_sf,
+// raising into soft_flags. The soft backend, or any backend when `soft`
+// holds, writes it and returns.
+#define SOFT_FP_IF(kind, soft, expr)                                      \
+  uint64_t soft_result = 0;                                               \
+  uint32_t soft_flags = 0;                                                \
+  if (fp_backend != FP_HOST || (soft)) {                                  \
+    soft_result = (expr);                                                 \
+    if (fp_backend == FP_SOFT || (soft)) {                                \
+      SOFT_WRITE_##kind(soft_result);                                     \
+      fp_pending |= soft_flags;                                           \
+      return;                                                             \
+    }                                                                     \
+  }
+#define SOFT_FP(kind, expr) SOFT_FP_IF(kind, false, expr)
+
+// Reserved rounding modes, in rm or through frm, are illegal
+#define FP_RM_LEGAL(rm)                                                   \
+  do {                                                                    \
+    if (FP_MODE(rm) > sf::RMM) {                                          \
+      fp_illegal_rm(rm);                                                  \
+      return;                                                             \
+    }                                                                     \
+  } while (0)
+
+// SOFT_FP of the behaviors that round with `rm`. The host FPU has no
+// RMM, so RMM results always come from riscv_sf.
+#define SOFT_FP_RM(kind, rm, expr)                                        \
+  FP_RM_LEGAL(rm);                                                        \
+  SOFT_FP_IF(kind, FP_MODE(rm) == sf::RMM, expr)
+
+// Bottom of an FP behavior: compare the host result in check mode
+#define SOFT_CHECK(kind, name)                                            \
+  do {                                                                    \
+    if (fp_backend == FP_CHECK &&                                         \
+        SOFT_HOST_##kind != SOFT_EXPECT_##kind(soft_result))              \
+      fp_mismatch(name, (ac_word)ac_pc - 4, SOFT_HOST_##kind,             \
+                  SOFT_EXPECT_##kind(soft_result));                       \
+  } while (0)
+
+// fflags bits
+#define FFLAG_NX 0x01
+#define FFLAG_UF 0x02
+#define FFLAG_OF 0x04
+#define FFLAG_DZ 0x08
+#define FFLAG_NV 0x10
+
+// Exception flags are left to accumulate in the host FPU and are only
+// harvested when the guest reads fflags/fcsr or another hart of this
+// host thread starts doing FP. FP_FLAGS() hands the host flags over to
+// the current hart; FFLAGS_SYNC() folds them into fflags.
+#define FP_FLAGS()                                                        \
+  do {                                                                    \
+    if (fp_owner != &fp_pending) {                                        \
+      uint32_t raised = host_fflags();                                    \
+      if (fp_owner)                                                       \
+        *fp_owner |= raised;                                              \
+      fp_owner = &fp_pending;                                             \
+    }                                                                     \
+  } while (0)
+#define FFLAGS_SYNC()                                                     \
+  do {                                                                    \
+    if (fp_owner == &fp_pending)                                          \
+      fp_pending |= host_fflags();                                        \
+    if (fp_pending) {                                                     \
+      fflags = fflags | fp_pending;                                       \
+      fcsr = (frm << 5) | fflags;                                         \
+      fp_pending = 0;                                                     \
+    }                                                                     \
+  } while (0)
+
+// Effective rounding mode of an instruction: rm 7 (DYN) selects frm
+#define FP_MODE(rm) ((rm) == 7 ? (unsigned)frm : (unsigned)(rm))
+
+// Install the rounding mode in the host FPU. fenv is only touched when
+// the mode differs from the one already installed, so code that stays
+// in round-to-nearest never calls fesetround().
+#define FP_ROUND(rm)                                                      \
+  do {                                                                    \
+    FP_FLAGS();                                                           \
+    if (FP_MODE(rm) != host_rm)                                           \
+      set_host_rounding(FP_MODE(rm));                                     \
+  } while (0)
+
+#define WRITE_DWORD(addr, value)                                          \
+  do {                                                                    \
+    uint64_t dword = (value);                                             \
+    if (SHM_HIT(addr)) {                                                  \
+      riscv_shm_store<uint64_t>(SHM_PTR(addr), dword);                    \
+    } else if (CLINT_HIT(addr)) {                                         \
+      clint_write(addr, dword, 8);                                        \
+    } else if (XLEN == 64) {                                              \
+      DM.write(addr, (ac_word)dword);                                     \
+    } else {                                                              \
+      DM.write(addr, (uint32_t)dword);                                    \
+      DM.write((addr) + 4, (uint32_t)(dword >> 32));                      \
+    }                                                                     \
+  } while (0)
+
 #define Ra 1
 #define Sp 14
 
+// Jumps to a routine bound by riscv_hle.H run it on the host and
+// return to ra
+#define HLE_JUMP()                                                        \
+  do {                                                                    \
+    if (riscv_hle::instance().active()) {                                 \
+      int func = riscv_hle::instance().find(ac_pc);                       \
+      if (func >= 0 && hle_call(func))                                    \
+        ac_pc = RB[Ra];                                                   \
+    }                                                                     \
+  } while (0)
+
+// Instructions of one XLEN only (RV64I/M/A/F/D, Zb*) stop as illegal
+// on the other
+#define XLEN_ONLY(bits)                                                   \
+  do {                                                                    \
+    if (XLEN != (bits)) {                                                 \
+      xlen_illegal();                                                     \
+      return;                                                             \
+    }                                                                     \
+  } while (0)
+
 // For using all the RISC-V parameters
 using namespace riscv_parms;
 
+typedef riscv_csr_table<riscv_isa, ac_word> csr_table;
+
+// Double-width integers for the MULH* products: 64 bits on RV32, the
+// host's 128-bit type on RV64
+template <int bytes> struct riscv_wide;
+template <> struct riscv_wide<4> {
+  typedef int64_t S;
+  typedef uint64_t U;
+};
+template <> struct riscv_wide<8> {
+  typedef __int128 S;
+  typedef unsigned __int128 U;
+};
+typedef riscv_wide<sizeof(ac_word)>::S ac_Swide;
+typedef riscv_wide<sizeof(ac_word)>::U ac_Uwide;
+
 static int processors_started = 0;
+static int processors_running = 0;
+
+// fp_pending of the hart whose exceptions the host flags hold
+static uint32_t *fp_owner = 0;
+
+// Read and clear the host exception flags, in fflags encoding
+static uint32_t host_fflags() {
+  int raised = fetestexcept(FE_ALL_EXCEPT);
+  uint32_t flags = 0;
+  if (!raised)
+    return 0;
+  if (raised & FE_INVALID)
+    flags |= FFLAG_NV;
+  if (raised & FE_DIVBYZERO)
+    flags |= FFLAG_DZ;
+  if (raised & FE_OVERFLOW)
+    flags |= FFLAG_OF;
+  if (raised & FE_UNDERFLOW)
+    flags |= FFLAG_UF;
+  if (raised & FE_INEXACT)
+    flags |= FFLAG_NX;
+  feclearexcept(FE_ALL_EXCEPT);
+  return flags;
+}
+
+// Host results that differ from the soft-float reference (RISCV_FP=check)
+static uint64_t fp_mismatches = 0;
+
+static void fp_mismatch(const char *name, uint32_t pc, uint64_t host,
+                        uint64_t soft) {
+  if (fp_mismatches++ < 20)
+    fprintf(stderr, "FP check: %s at pc %#x, host %#llx soft %#llx\n", name,
+            pc, (unsigned long long)host, (unsigned long long)soft);
+}
+
+// Host rounding mode, RISC-V encoding. The host starts in RNE.
+static unsigned host_rm = 0;
+
+// RMM has no host equivalent: rounding operations in RMM run in
+// riscv_sf (SOFT_FP_RM, rvv_soft_fp) and conversions to integer
+// implement it in fcvt_int(). Its slot here only serves the vector
+// operations that do not round.
+static void set_host_rounding(unsigned mode) {
+  static const int host_modes[8] = {
+    FE_TONEAREST, FE_TOWARDZERO, FE_DOWNWARD, FE_UPWARD,
+    FE_TONEAREST, FE_TONEAREST, FE_TONEAREST, FE_TONEAREST
+  };
+  fesetround(host_modes[mode & 7]);
+  host_rm = mode;
+}
+
+// Fused multiply-add with a single rounding. fma()/fmaf() are always
+// correct but may be a software routine; when the host has FMA3 the
+// behaviors call a copy compiled to use the instruction directly.
+static float soft_fma_s(float a, float b, float c) { return fmaf(a, b, c); }
+static double soft_fma_d(double a, double b, double c) { return fma(a, b, c); }
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("fma")))
+static float fma3_s(float a, float b, float c) { return __builtin_fmaf(a, b, c); }
+__attribute__((target("fma")))
+static double fma3_d(double a, double b, double c) { return __builtin_fma(a, b, c); }
+
+static bool host_has_fma() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("fma");
+}
+
+static float (*const fused_s)(float, float, float) =
+    host_has_fma() ? fma3_s : soft_fma_s;
+static double (*const fused_d)(double, double, double) =
+    host_has_fma() ? fma3_d : soft_fma_d;
+#else
+static float (*const fused_s)(float, float, float) = soft_fma_s;
+static double (*const fused_d)(double, double, double) = soft_fma_d;
+#endif
+
+// Step a truncated conversion result away from zero by the discarded
+// fraction, as rounding mode `mode` asks
+static inline int64_t fcvt_step(int64_t result, double fraction,
+                                unsigned mode) {
+  switch (mode) {
+  case 1:                                           // RTZ
+    return result;
+  case 2:                                           // RDN
+    return result - (fraction < 0);
+  case 3:                                           // RUP
+    return result + (fraction > 0);
+  case 4:                                           // RMM
+    return result + (fraction >= 0.5) - (fraction <= -0.5);
+  default: {                                        // RNE
+    int64_t odd = result & 1;
+    return result + ((fraction > 0.5) | ((fraction == 0.5) & odd)) -
+           ((fraction < -0.5) | ((fraction == -0.5) & odd));
+  }
+  }
+}
+
+// FCVT.W[U].S/D. Every 32-bit integer is exact in a double, so singles
+// take the same path. Rounding never goes through fenv or libm, so the
+// static RTZ that compilers emit does not flip the host mode. Results
+// outside the destination range, NaNs included, saturate with NV;
+// inexact in-range results raise NX.
+//
+// The generic version clamps to +-2^33, truncates with one host
+// conversion and steps away from zero by the discarded fraction.
+static uint32_t fcvt_int_generic(double x, unsigned mode, bool is_signed,
+                                 uint32_t &flags) {
+  const double bound = 8589934592.0;
+  double clamped = x > -bound ? x : -bound;
+  clamped = clamped < bound ? clamped : bound;
+  int64_t result = (int64_t)clamped;
+  double fraction = clamped - (double)result;       // exact, in (-1, 1)
+
+  result = fcvt_step(result, fraction, mode);
+
+  int64_t lo = is_signed ? INT32_MIN : 0;
+  int64_t hi = is_signed ? INT32_MAX : UINT32_MAX;
+  if (__builtin_expect(result < lo || result > hi || x != x, 0)) {
+    flags |= FFLAG_NV;
+    return (uint32_t)(result < lo && x == x ? lo : hi);
+  }
+  if (fraction != 0)
+    flags |= FFLAG_NX;
+  return (uint32_t)result;
+}
+
+// FCVT.L[U].S/D (RV64). Below 2^52 a double may have a fraction and
+// takes the truncate-and-step path, from there up it is integral and
+// only the range is checked.
+static uint64_t fcvt_long(double x, unsigned mode, bool is_signed,
+                          uint32_t &flags) {
+  const double two52 = 4503599627370496.0;
+  const double two63 = 9223372036854775808.0;
+
+  if (x > -two52 && x < two52) {
+    int64_t result = (int64_t)x;
+    double fraction = x - (double)result;
+    result = fcvt_step(result, fraction, mode);
+    if (!is_signed && result < 0) {
+      flags |= FFLAG_NV;
+      return 0;
+    }
+    if (fraction != 0)
+      flags |= FFLAG_NX;
+    return (uint64_t)result;
+  }
+
+  double lo = is_signed ? -two63 : 0.0;
+  double hi = is_signed ? two63 : 2 * two63;
+  if (!(x >= lo && x < hi)) {
+    flags |= FFLAG_NV;
+    if (x < lo)
+      return is_signed ? (uint64_t)INT64_MIN : 0;
+    return is_signed ? (uint64_t)INT64_MAX : UINT64_MAX;
+  }
+  return is_signed ? (uint64_t)(int64_t)x : (uint64_t)x;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// SSE4.1 rounds to an integral value in any static mode with one
+// ROUNDSD (RMM truncates, then steps); range and exactness are then
+// plain compares
+__attribute__((target("sse4.1")))
+static uint32_t fcvt_int_sse41(double x, unsigned mode, bool is_signed,
+                               uint32_t &flags) {
+  const int quiet = _MM_FROUND_NO_EXC;
+  __m128d v = _mm_set_sd(x);
+  double r;
+
+  switch (mode) {
+  case 1:  v = _mm_round_sd(v, v, _MM_FROUND_TO_ZERO | quiet); break;
+  case 2:  v = _mm_round_sd(v, v, _MM_FROUND_TO_NEG_INF | quiet); break;
+  case 3:  v = _mm_round_sd(v, v, _MM_FROUND_TO_POS_INF | quiet); break;
+  case 4:  v = _mm_round_sd(v, v, _MM_FROUND_TO_ZERO | quiet); break;
+  default: v = _mm_round_sd(v, v, _MM_FROUND_TO_NEAREST_INT | quiet); break;
+  }
+  r = _mm_cvtsd_f64(v);
+  if (mode == 4) {
+    // RMM: ROUNDSD has no ties-away mode, so step the truncated value
+    // away from zero when the (exact) discarded fraction is half or more
+    double fraction = x - r;
+    if (fraction >= 0.5)
+      r += 1.0;
+    else if (fraction <= -0.5)
+      r -= 1.0;
+  }
+
+  double lo = is_signed ? -2147483648.0 : 0.0;
+  double hi = is_signed ? 2147483647.0 : 4294967295.0;
+  if (__builtin_expect(!(r >= lo && r <= hi), 0)) {
+    flags |= FFLAG_NV;
+    return (uint32_t)(int64_t)(r < lo ? lo : hi);
+  }
+  if (r != x)
+    flags |= FFLAG_NX;
+  return (uint32_t)(int64_t)r;
+}
+
+static bool host_has_sse41() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.1");
+}
+
+static uint32_t (*const fcvt_int)(double, unsigned, bool, uint32_t &) =
+    host_has_sse41() ? fcvt_int_sse41 : fcvt_int_generic;
+#else
+static uint32_t (*const fcvt_int)(double, unsigned, bool, uint32_t &) =
+    fcvt_int_generic;
+#endif
+// FCLASS result masks, indexed by sign << 4 | kind << 2 | (fraction != 0)
+// << 1 | quiet bit, kind being 0 for a zero exponent, 1 for a normal one
+// and 2 for all ones. Unreachable combinations are 0.
+static const uint16_t fclass_table[32] = {
+  0x010, 0, 0x020, 0x020, 0x040, 0x040, 0x040, 0x040,  // +0, +sub, +normal
+  0x080, 0, 0x100, 0x200, 0, 0, 0, 0,                  // +inf, sNaN, qNaN
+  0x008, 0, 0x004, 0x004, 0x002, 0x002, 0x002, 0x002,  // -0, -sub, -normal
+  0x001, 0, 0x100, 0x200, 0, 0, 0, 0                   // -inf, sNaN, qNaN
+};
+
+static uint32_t fclass(uint64_t bits, int exp_bits, int frac_bits) {
+  uint64_t fraction = bits & ((1ULL << frac_bits) - 1);
+  uint32_t exp = (bits >> frac_bits) & ((1u << exp_bits) - 1);
+  uint32_t sign = (bits >> (exp_bits + frac_bits)) & 1;
+  uint32_t kind = (exp != 0) + (exp == (1u << exp_bits) - 1);
+  uint32_t quiet = (fraction >> (frac_bits - 1)) & 1;
+  return fclass_table[sign << 4 | kind << 2 | (fraction != 0) << 1 | quiet];
+}
+
+// FMIN/FMAX on the host, with sf::minmax's rules: a NaN loses to a
+// number, two NaNs give the canonical NaN and -0 orders below +0. The
+// compares are quiet; callers raise NV for signaling NaNs only.
+template <class T> static T fp_minmax(T a, T b, bool is_max) {
+  if (__builtin_isnan(a))
+    return __builtin_isnan(b) ? (T)__builtin_nan("") : b;
+  if (__builtin_isnan(b))
+    return a;
+  bool a_sign = __builtin_signbit(a) != 0, b_sign = __builtin_signbit(b) != 0;
+  bool a_below = a_sign != b_sign ? a_sign : __builtin_isless(a, b);
+  return a_below != is_max ? a : b;
+}
+
+// Zbb rotates, by the amount mod 32; the host compiler turns the pair
+// of shifts into its rotate instruction
+static inline uint32_t rotate_left(uint32_t x, uint32_t amount) {
+  amount &= 31;
+  return (x << amount) | (x >> ((32 - amount) & 31));
+}
+
 #define DEFAULT_STACK_SIZE (512 * 1024);
 
+// Run a routine bound by riscv_hle.H on the host
+bool riscv_isa::hle_call(int func) {
+  bool done;
+
+  switch (riscv_hle_table[func].group) {
+  case HLE_SOFTFLOAT: done = hle_softfloat(func); break;
+  case HLE_LIBM:      done = hle_libm(func); break;
+  default:            done = hle_string(func); break;
+  }
+  if (done)
+    riscv_hle::instance().hit(func);
+  return done;
+}
+
+// libgcc soft-float routines. Arguments come in a0-a3, doubles and
+// 64-bit integers as register pairs with the low word first; results go
+// to a0 (a0/a1 for 64 bits, a1 is caller-saved and always written). The
+// host computes in RNE and the flags it raises are dropped, -msoft-float
+// code has no fflags.
+bool riscv_isa::hle_softfloat(int func) {
+  if (XLEN == 64)               // lp64 passes doubles in one register
+    return false;
+  uint32_t a0 = RB[10], a1 = RB[11], a2 = RB[12], a3 = RB[13];
+  double da = riscv_hle_d(a0, a1), db = riscv_hle_d(a2, a3);
+  float sa = riscv_hle_s(a0), sb = riscv_hle_s(a1);
+  int64_t da64 = (int64_t)((uint64_t)a1 << 32 | a0);
+  uint64_t r;
+
+  FP_ROUND(0);
+  fp_pending |= host_fflags();
+  switch (func) {
+  case HLE_ADDDF3:      r = riscv_hle_bits_d(da + db); break;
+  case HLE_SUBDF3:      r = riscv_hle_bits_d(da - db); break;
+  case HLE_MULDF3:      r = riscv_hle_bits_d(da * db); break;
+  case HLE_DIVDF3:      r = riscv_hle_bits_d(da / db); break;
+  case HLE_NEGDF2:      r = (uint64_t)(a1 ^ 0x80000000) << 32 | a0; break;
+  case HLE_EQDF2:
+  case HLE_NEDF2:       r = (uint32_t)riscv_hle_cmp(da, db, 1); break;
+  case HLE_GTDF2:
+  case HLE_GEDF2:       r = (uint32_t)riscv_hle_cmp(da, db, -1); break;
+  case HLE_LTDF2:
+  case HLE_LEDF2:       r = (uint32_t)riscv_hle_cmp(da, db, 1); break;
+  case HLE_UNORDDF2:    r = da != da || db != db; break;
+  case HLE_FIXDFSI:     r = (uint32_t)riscv_hle_fix(da, a1 >> 31, 32); break;
+  case HLE_FIXUNSDFSI:  r = riscv_hle_fixuns(da, a1 >> 31, 32); break;
+  case HLE_FIXDFDI:     r = riscv_hle_fix(da, a1 >> 31, 64); break;
+  case HLE_FIXUNSDFDI:  r = riscv_hle_fixuns(da, a1 >> 31, 64); break;
+  case HLE_FLOATSIDF:   r = riscv_hle_bits_d((int32_t)a0); break;
+  case HLE_FLOATUNSIDF: r = riscv_hle_bits_d(a0); break;
+  case HLE_FLOATDIDF:   r = riscv_hle_bits_d(da64); break;
+  case HLE_FLOATUNDIDF: r = riscv_hle_bits_d((uint64_t)da64); break;
+  case HLE_EXTENDSFDF2: r = riscv_hle_bits_d(sa); break;
+  case HLE_TRUNCDFSF2:  r = riscv_hle_bits_s((float)da); break;
+  case HLE_ADDSF3:      r = riscv_hle_bits_s(sa + sb); break;
+  case HLE_SUBSF3:      r = riscv_hle_bits_s(sa - sb); break;
+  case HLE_MULSF3:      r = riscv_hle_bits_s(sa * sb); break;
+  case HLE_DIVSF3:      r = riscv_hle_bits_s(sa / sb); break;
+  case HLE_NEGSF2:      r = a0 ^ 0x80000000; break;
+  case HLE_EQSF2:
+  case HLE_NESF2:       r = (uint32_t)riscv_hle_cmp(sa, sb, 1); break;
+  case HLE_GTSF2:
+  case HLE_GESF2:       r = (uint32_t)riscv_hle_cmp(sa, sb, -1); break;
+  case HLE_LTSF2:
+  case HLE_LESF2:       r = (uint32_t)riscv_hle_cmp(sa, sb, 1); break;
+  case HLE_UNORDSF2:    r = sa != sa || sb != sb; break;
+  case HLE_FIXSFSI:     r = (uint32_t)riscv_hle_fix(sa, a0 >> 31, 32); break;
+  case HLE_FIXUNSSFSI:  r = riscv_hle_fixuns(sa, a0 >> 31, 32); break;
+  case HLE_FIXSFDI:     r = riscv_hle_fix(sa, a0 >> 31, 64); break;
+  case HLE_FIXUNSSFDI:  r = riscv_hle_fixuns(sa, a0 >> 31, 64); break;
+  case HLE_FLOATSISF:   r = riscv_hle_bits_s((float)(int32_t)a0); break;
+  case HLE_FLOATUNSISF: r = riscv_hle_bits_s((float)a0); break;
+  case HLE_FLOATDISF:   r = riscv_hle_bits_s((float)da64); break;
+  case HLE_FLOATUNDISF: r = riscv_hle_bits_s((float)(uint64_t)da64); break;
+  default:
+    return false;
+  }
+  host_fflags();
+
+  RB[10] = (uint32_t)r;
+  RB[11] = (uint32_t)(r >> 32);
+  dbg_printf("HLE %s = %#llx\n", riscv_hle_table[func].name,
+             (unsigned long long)r);
+  return true;
+}
+
+// newlib sqrt, sin, cos and atan. The double argument and result are in
+// fa0 for ilp32d programs and in a0/a1 for soft-float ones. Results are
+// bit-exact in round to nearest, so other modes and the cases that set
+// errno (sqrt of a negative) or need the large-argument reduction run
+// the guest code. Under ilp32d the host flags go to fflags as the guest
+// instructions would raise them.
+bool riscv_isa::hle_libm(int func) {
+  riscv_hle &hle = riscv_hle::instance();
+  double x, r;
+
+  if (hle.hard_float) {
+    if (frm != 0)
+      return false;
+    x = load_double(10);
+  } else if (XLEN == 64) {
+    return false;
+  } else {
+    x = riscv_hle_d(RB[10], RB[11]);
+  }
+
+  FP_ROUND(0);
+  if (!hle.hard_float)
+    fp_pending |= host_fflags();
+  switch (func) {
+  case HLE_SQRT:
+    if (x < 0)
+      return false;
+    r = sqrt(x);
+    break;
+  case HLE_SIN:
+    if (hle.host_libm)
+      r = sin(x);
+    else if (!riscv_fdlibm::sin(x, r))
+      return false;
+    break;
+  case HLE_COS:
+    if (hle.host_libm)
+      r = cos(x);
+    else if (!riscv_fdlibm::cos(x, r))
+      return false;
+    break;
+  default:
+    r = hle.host_libm ? atan(x) : riscv_fdlibm::atan(x);
+    break;
+  }
+
+  uint64_t bits = riscv_hle_bits_d(r);
+  if (hle.hard_float) {
+    RBF[10] = bits;
+  } else {
+    host_fflags();
+    RB[10] = (uint32_t)bits;
+    RB[11] = (uint32_t)(bits >> 32);
+  }
+  dbg_printf("HLE %s(%g) = %g\n", riscv_hle_table[func].name, x, r);
+  return true;
+}
+
+// memcpy, memset and strlen through the regular load/store paths, a
+// word at a time where the addresses allow it. A range that touches the
+// stack guard area is left to the guest code, whose own access faults.
+#define GUARD_RANGE(p, n)                                                 \
+  ((n) && ((ac_word)(guard_lo - (p)) < (n) ||                             \
+           (ac_word)((p) - guard_lo) < guard_size))
+bool riscv_isa::hle_string(int func) {
+  ac_word dst = RB[10], src = RB[11], n = RB[12];   // XLEN-wide on RV64
+
+  switch (func) {
+  case HLE_MEMCPY:
+    if (GUARD_RANGE(dst, n) || GUARD_RANGE(src, n))
+      return false;
+    if (((dst ^ src) & 3) == 0) {
+      for (; n && (dst & 3); n--, dst++, src++) {
+        MEM_READ_COUNT(src, 1);
+        MEM_WRITE_COUNT(dst, 1);
+        WRITE_BYTE(dst, READ_BYTE(src));
+      }
+      for (; n >= 4; n -= 4, dst += 4, src += 4) {
+        MEM_READ_COUNT(src, 4);
+        MEM_WRITE_COUNT(dst, 4);
+        WRITE_WORD(dst, READ_WORD(src));
+      }
+    }
+    for (; n; n--, dst++, src++) {
+      MEM_READ_COUNT(src, 1);
+      MEM_WRITE_COUNT(dst, 1);
+      WRITE_BYTE(dst, READ_BYTE(src));
+    }
+    break;
+  case HLE_MEMSET: {
+    if (GUARD_RANGE(dst, n))
+      return false;
+    uint32_t byte = src & 0xFF, word = byte * 0x01010101;
+    for (; n && (dst & 3); n--, dst++) {
+      MEM_WRITE_COUNT(dst, 1);
+      WRITE_BYTE(dst, byte);
+    }
+    for (; n >= 4; n -= 4, dst += 4) {
+      MEM_WRITE_COUNT(dst, 4);
+      WRITE_WORD(dst, word);
+    }
+    for (; n; n--, dst++) {
+      MEM_WRITE_COUNT(dst, 1);
+      WRITE_BYTE(dst, byte);
+    }
+    break;
+  }
+  default: {
+    ac_word end = dst;
+    for (;; end++) {
+      if ((end & 3) == 0) {
+        if (GUARD_RANGE(end, 4))
+          return false;
+        MEM_READ_COUNT(end, 4);
+        uint32_t word = READ_WORD(end);
+        if (((word - 0x01010101) & ~word & 0x80808080) == 0) {
+          end += 3;
+          continue;
+        }
+      }
+      if (GUARD_HIT(end))
+        return false;
+      MEM_READ_COUNT(end, 1);
+      if (READ_BYTE(end) == 0)
+        break;
+    }
+    RB[10] = end - dst;
+    return true;
+  }
+  }
+  // memcpy and memset return the destination, already in a0
+  return true;
+}
+
+// AMO*.W and AMO*.D. The old value is read before rd is written, so rd
+// may be rs1 or rs2; on the shared window the whole update is atomic.
+void riscv_isa::amo(int op, bool dword, unsigned rd, ac_word addr,
+                    ac_word value) {
+  riscv_amo kind = (riscv_amo)op;
+
+  STORE_ALIGN(addr, dword ? 8 : 4);
+  HPM_COUNT(HPM_AMOS);
+  MEM_WRITE_HOOK(addr, dword ? 8 : 4);
+  if (dword) {
+    uint64_t old;
+    if (SHM_HIT(addr)) {
+      old = riscv_shm_amo<uint64_t>(SHM_PTR(addr), kind, value);
+    } else {
+      old = READ_DWORD(addr);
+      WRITE_DWORD(addr, riscv_amo_apply<uint64_t>(kind, old, value));
+    }
+    RB[rd] = old;
+    return;
+  }
+  uint32_t old;
+  if (SHM_HIT(addr)) {
+    old = riscv_shm_amo<uint32_t>(SHM_PTR(addr), kind, value);
+  } else {
+    old = READ_WORD(addr);
+    WRITE_WORD(addr, riscv_amo_apply<uint32_t>(kind, old, value));
+  }
+  RB[rd] = (int32_t)old;
+}
+
+// RV64-only instructions on riscv.ac, Zb* on riscv64.ac
+void riscv_isa::xlen_illegal() {
+  if (trap(RISCV_CAUSE_ILLEGAL_INSN, 0))
+    return;
+  fprintf(stderr, "Hart %d: illegal instruction for RV%d at pc %#x\n", hartid,
+          (int)XLEN, (uint32_t)ac_pc - 4);
+  stop();
+}
+
+// Stop on a reserved rounding mode, in rm or in frm for rm 7 (DYN)
+void riscv_isa::fp_illegal_rm(unsigned rm) {
+  if (trap(RISCV_CAUSE_ILLEGAL_INSN, 0))
+    return;
+  fprintf(stderr, "Hart %d: reserved rounding mode %u (frm %u) at pc %#x\n",
+          hartid, rm, (unsigned)frm, (uint32_t)ac_pc - 4);
+  stop();
+}
+
+// Access fault on the guard area, tval is the address; without a
+// handler the hart stops with a stack overflow message
+void riscv_isa::stack_fault(ac_word addr, unsigned cause) {
+  if (trap(cause, addr))
+    return;
+  fprintf(stderr, "Hart %d: stack overflow, access to %#x in the guard "
+          "area (pc %#x)\n", hartid, (uint32_t)addr, (uint32_t)ac_pc - 4);
+  stop();
+}
+
+// Compressed instructions. The generic behavior has advanced the PC by
+// 4 and it stays there while the expansion runs, so ac_pc - 4 is this
+// instruction as in the 32-bit behaviors (the memory hooks and the
+// spin detector rely on it); at the end it moves to pc + 2, the link
+// value of C.JAL/C.JALR, unless the instruction jumped.
+void riscv_isa::rvc_execute(uint16_t bits) {
+  const riscv_rvc_op &op =
+      riscv_rvc::instance().lookup(ac_pc - 4, bits, XLEN == 64);
+  ac_word next = ac_pc - 2, addr = RB[op.rs1] + op.imm, target;
+
+  dbg_printf("RVC %#06x: kind %d rd r%d rs1 r%d rs2 r%d imm %d\n", bits,
+             op.kind, op.rd, op.rs1, op.rs2, op.imm);
+  switch (op.kind) {
+  case RVC_ADDI: RB[op.rd] = addr; break;
+  case RVC_LUI:  RB[op.rd] = op.imm; break;
+  case RVC_SLLI: RB[op.rd] = RB[op.rs1] << op.imm; break;
+  case RVC_SRLI: RB[op.rd] = RB[op.rs1] >> op.imm; break;
+  case RVC_SRAI: RB[op.rd] = (ac_Sword)RB[op.rs1] >> op.imm; break;
+  case RVC_ANDI: RB[op.rd] = RB[op.rs1] & op.imm; break;
+  case RVC_ADD:  RB[op.rd] = RB[op.rs1] + RB[op.rs2]; break;
+  case RVC_SUB:  RB[op.rd] = RB[op.rs1] - RB[op.rs2]; break;
+  case RVC_XOR:  RB[op.rd] = RB[op.rs1] ^ RB[op.rs2]; break;
+  case RVC_OR:   RB[op.rd] = RB[op.rs1] | RB[op.rs2]; break;
+  case RVC_AND:  RB[op.rd] = RB[op.rs1] & RB[op.rs2]; break;
+  case RVC_ADDIW: RB[op.rd] = (int32_t)addr; break;
+  case RVC_ADDW: RB[op.rd] = (int32_t)(RB[op.rs1] + RB[op.rs2]); break;
+  case RVC_SUBW: RB[op.rd] = (int32_t)(RB[op.rs1] - RB[op.rs2]); break;
+  case RVC_LW:
+    LOAD_ALIGN(addr, 4);
+    MEM_READ_HOOK(addr, 4);
+    RB[op.rd] = (int32_t)READ_WORD(addr);
+    break;
+  case RVC_LD:
+    LOAD_ALIGN(addr, 8);
+    MEM_READ_HOOK(addr, 8);
+    RB[op.rd] = READ_DWORD(addr);
+    break;
+  case RVC_SD:
+    STORE_ALIGN(addr, 8);
+    MEM_WRITE_HOOK(addr, 8);
+    WRITE_DWORD(addr, RB[op.rs2]);
+    break;
+  case RVC_SW:
+    STORE_ALIGN(addr, 4);
+    MEM_WRITE_HOOK(addr, 4);
+    WRITE_WORD(addr, RB[op.rs2]);
+    break;
+  case RVC_FLW:
+    LOAD_ALIGN(addr, 4);
+    FP_PROFILE(0, 4);
+    MEM_READ_HOOK(addr, 4);
+    save_float_bits(READ_WORD(addr), op.rd);
+    break;
+  case RVC_FSW:
+    STORE_ALIGN(addr, 4);
+    FP_PROFILE(0, 4);
+    MEM_WRITE_HOOK(addr, 4);
+    WRITE_WORD(addr, (uint32_t)RBF[op.rs2]);
+    break;
+  case RVC_FLD:
+    LOAD_ALIGN(addr, 8);
+    FP_PROFILE(0, 8);
+    MEM_READ_HOOK(addr, 8);
+    RBF[op.rd] = READ_DWORD(addr);
+    break;
+  case RVC_FSD:
+    STORE_ALIGN(addr, 8);
+    FP_PROFILE(0, 8);
+    MEM_WRITE_HOOK(addr, 8);
+    WRITE_DWORD(addr, RBF[op.rs2]);
+    break;
+  case RVC_BEQ:
+  case RVC_BNE:
+    if ((RB[op.rs1] == 0) != (op.kind == RVC_BEQ))
+      break;
+    target = ac_pc - 4 + op.imm;
+    HPM_COUNT(HPM_BRANCHES);
+    IDLE_BRANCH(target);
+    ac_pc = target;
+    IRQ_CHECK();
+    return;
+  case RVC_JAL:
+  case RVC_JALR:
+    target = op.kind == RVC_JAL ? ac_pc - 4 + op.imm
+                                : RB[op.rs1] & ~(ac_word)1;
+    RB[op.rd] = next;
+    if (op.kind == RVC_JAL)
+      IDLE_BRANCH(target);
+    ac_pc = target;
+    if (ac_pc == riscv_forksrv_target() && ac_pc != 0)
+      riscv_forksrv_run();
+    HLE_JUMP();
+    IRQ_CHECK();
+    return;
+  case RVC_EBREAK:
+    if (trap(RISCV_CAUSE_BREAKPOINT, ac_pc - 4))
+      return;
+    printf("Breakpoint\n\n");
+    stop();
+    break;
+  default:
+    if (trap(RISCV_CAUSE_ILLEGAL_INSN, 0))
+      return;
+    fprintf(stderr, "Hart %d: illegal compressed instruction %#06x at pc "
+            "%#x\n", hartid, bits, (uint32_t)ac_pc - 4);
+    stop();
+    break;
+  }
+  ac_pc = next;
+}
+
+
+
+// Unsupported vtype, misaligned register group or an encoding the
+// subset leaves out
+void riscv_isa::rvv_illegal(const char *why) {
+  if (trap(RISCV_CAUSE_ILLEGAL_INSN, 0))
+    return;
+  fprintf(stderr, "Hart %d: illegal vector instruction at pc %#x: %s "
+          "(vtype %#x)\n", hartid, (uint32_t)ac_pc - 4, why,
+          (uint32_t)vtype);
+  stop();
+}
+
+// Operand group v`reg`..v`reg + regs - 1` under a legal vtype
+bool riscv_isa::rvv_legal(unsigned reg, unsigned regs) {
+  if (vtype >> (XLEN - 1))
+    rvv_illegal("vill");
+  else if (regs > 8 || reg % regs != 0 || reg + regs > 32)
+    rvv_illegal("register group");
+  else
+    return true;
+  return false;
+}
+
+// vsetvli/vsetivli/vsetvl. `avl_reg` is rs1 of the register forms (x0
+// asks for VLMAX, or keeps vl when rd is x0 too), -1 for the immediate
+// AVL of vsetivli. vl is min(AVL, VLMAX); an unsupported vtype sets vill.
+void riscv_isa::rvv_setvl(unsigned rd, int avl_reg, uint64_t avl,
+                          uint64_t type) {
+  uint32_t vlmax = riscv_rvv::vlmax(type);
+  vector_count++;
+
+  if (vlmax == 0) {
+    vtype = (ac_word)1 << (XLEN - 1);
+    vl = 0;
+  } else {
+    vtype = type;
+    if (avl_reg != 0)
+      vl = (uint32_t)std::min<uint64_t>(avl, vlmax);
+    else if (rd != 0)
+      vl = vlmax;
+    else
+      vl = std::min((uint32_t)vl, vlmax);
+  }
+  RB[rd] = vl;
+}
+
+// Vector arithmetic. The second operand is vs1, x[rs1], f[rs1] or the
+// 5-bit immediate (zero-extended for the shifts); riscv_rvv::find() has
+// the kernels. The element moves of funct6 0x10 are done here.
+void riscv_isa::rvv_execute(unsigned funct3, unsigned funct6, unsigned vm,
+                            unsigned vs2, unsigned vs1, unsigned vd) {
+  unsigned sew = (vtype >> 3) & 7, bytes = 1u << sew;
+  bool vector_operand = funct3 <= RVV_OPMVV;
+  uint32_t x;
+
+  vector_count++;
+
+  switch (funct3) {
+  case RVV_OPIVI: x = funct6 >= 0x25 ? vs1 : sign_extend(vs1, 5); break;
+  case RVV_OPFVF: x = load_float_bits(vs1); break;
+  default:        x = RB[vs1]; break;
+  }
+
+  if (funct6 == 0x10) {
+    if (!rvv_legal(0, 1))
+      return;
+    uint8_t *v = vregs + (vector_operand ? vs2 : vd) * RVV_VLENB;
+    int32_t first = 0;
+    memcpy(&first, v, bytes);
+    first = (int32_t)((uint32_t)first << (32 - 8 * bytes)) >> (32 - 8 * bytes);
+    if (funct3 == RVV_OPMVV && vs1 == 0) {              // vmv.x.s
+      RB[vd] = first;
+      return;
+    }
+    if (funct3 == RVV_OPFVV && vs1 == 0 && sew == 2) {  // vfmv.f.s
+      save_float_bits(first, vd);
+      return;
+    }
+    if ((funct3 == RVV_OPMVX || (funct3 == RVV_OPFVF && sew == 2)) &&
+        vs2 == 0) {                                     // vmv.s.x, vfmv.s.f
+      if (vl != 0)
+        memcpy(v, &x, bytes);
+      return;
+    }
+    rvv_illegal("reserved move encoding");
+    return;
+  }
+
+  bool reduction = (funct3 == RVV_OPMVV && funct6 < 8) ||
+                   (funct3 == RVV_OPFVV && (funct6 & 0x39) == 1);
+  riscv_rvv::kernel kernel = riscv_rvv::find(funct3, funct6, sew);
+  unsigned regs = riscv_rvv::group(vtype);
+  if (!kernel) {
+    rvv_illegal(sew > 2 ? "vill" : "funct6 not implemented");
+    return;
+  }
+  if (!rvv_legal(vs2, regs) ||
+      (!reduction && (!rvv_legal(vd, regs) ||
+                      (vector_operand && !rvv_legal(vs1, regs)))))
+    return;
+
+  if (funct3 == RVV_OPFVV || funct3 == RVV_OPFVF) {
+    // Vector FP instructions take frm, and trap on a reserved one even
+    // when they do not round
+    if (frm > sf::RMM) {
+      rvv_illegal("reserved frm");
+      return;
+    }
+    bool rounds = funct6 <= 0x03 || funct6 >= 0x20;
+    if (rounds && frm == sf::RMM) {
+      rvv_soft_fp(funct6, vm, vs2, vector_operand ? vs1 : -1, x, vd,
+                  reduction);
+      return;
+    }
+    FP_ROUND(7);
+  }
+  dbg_printf("vector funct3 %u funct6 %#x v%u, v%u, %u vl %u\n", funct3,
+             funct6, vd, vs2, vs1, (uint32_t)vl);
+  kernel(vregs + vd * RVV_VLENB, vregs + vs2 * RVV_VLENB,
+         vector_operand ? vregs + vs1 * RVV_VLENB : 0, x, vl,
+         vm ? 0 : vregs);
+}
+
+// One element of a rounding vector FP instruction in riscv_sf: a = vs2,
+// b = vs1 or f[rs1], c = vd, as in the riscv_rvv.H operations
+static uint32_t rvv_soft_element(unsigned funct6, uint32_t a, uint32_t b,
+                                 uint32_t c, unsigned rm, uint32_t &flags) {
+  const uint32_t neg = sf::f32::SIGN;
+  switch (funct6) {
+  case 0x02: return sf::sub<sf::f32>(a, b, rm, flags);
+  case 0x20: return sf::div<sf::f32>(a, b, rm, flags);
+  case 0x21: return sf::div<sf::f32>(b, a, rm, flags);
+  case 0x24: return sf::mul<sf::f32>(a, b, rm, flags);
+  case 0x27: return sf::sub<sf::f32>(b, a, rm, flags);
+  case 0x28: return sf::fma<sf::f32>(b, c, a, rm, flags);
+  case 0x29: return sf::fma<sf::f32>(b ^ neg, c, a ^ neg, rm, flags);
+  case 0x2A: return sf::fma<sf::f32>(b, c, a ^ neg, rm, flags);
+  case 0x2B: return sf::fma<sf::f32>(b ^ neg, c, a, rm, flags);
+  case 0x2C: return sf::fma<sf::f32>(b, a, c, rm, flags);
+  case 0x2D: return sf::fma<sf::f32>(b ^ neg, a, c ^ neg, rm, flags);
+  case 0x2E: return sf::fma<sf::f32>(b, a, c ^ neg, rm, flags);
+  case 0x2F: return sf::fma<sf::f32>(b ^ neg, a, c, rm, flags);
+  default:   return sf::add<sf::f32>(a, b, rm, flags);  // vfadd, vfred*sum
+  }
+}
+
+// Rounding vector FP instructions in a mode the host FPU lacks (RMM),
+// element by element in riscv_sf. vs1 is -1 for the scalar operand x.
+void riscv_isa::rvv_soft_fp(unsigned funct6, unsigned vm, unsigned vs2,
+                            int vs1, uint32_t x, unsigned vd,
+                            bool reduction) {
+  const uint8_t *a = vregs + vs2 * RVV_VLENB;
+  const uint8_t *b = vs1 >= 0 ? vregs + vs1 * RVV_VLENB : 0;
+  const uint8_t *mask = vm ? 0 : vregs;
+  uint8_t *d = vregs + vd * RVV_VLENB;
+  uint32_t flags = 0;
+
+  if (reduction) {
+    if (vl == 0)
+      return;
+    uint32_t acc = riscv_rvv::element<uint32_t>(b, 0);
+    for (unsigned i = 0; i < vl; i++)
+      if (riscv_rvv::active(mask, i))
+        acc = rvv_soft_element(funct6, acc, riscv_rvv::element<uint32_t>(a, i),
+                               acc, sf::RMM, flags);
+    memcpy(d, &acc, sizeof(acc));
+  } else {
+    for (unsigned i = 0; i < vl; i++) {
+      if (!riscv_rvv::active(mask, i))
+        continue;
+      uint32_t r = rvv_soft_element(
+          funct6, riscv_rvv::element<uint32_t>(a, i),
+          b ? riscv_rvv::element<uint32_t>(b, i) : x,
+          riscv_rvv::element<uint32_t>(d, i), sf::RMM, flags);
+      memcpy(d + i * sizeof(r), &r, sizeof(r));
+    }
+  }
+  fp_pending |= flags;
+}
+
+// Unit-stride and strided loads and stores of `size`-byte elements.
+// Unmasked unit-stride accesses move whole words where the address is
+// aligned; the rest goes element by element through the usual hooks.
+void riscv_isa::rvv_memory(bool store, unsigned vd, ac_word addr,
+                           ac_word stride, unsigned size, unsigned vm) {
+  uint8_t *v = vregs + vd * RVV_VLENB;
+  const uint8_t *mask = vm ? 0 : vregs;
+  uint32_t n = vl, bytes = n * size, value;
+
+  vector_count++;
+
+  if (!rvv_legal(vd, riscv_rvv::emul(vtype, size)))
+    return;
+
+  if (!mask && stride == size) {
+    uint32_t i = 0;
+    if ((addr & 3) == 0) {
+      for (; i + 4 <= bytes; i += 4) {
+        if (store) {
+          memcpy(&value, v + i, 4);
+          MEM_WRITE_HOOK(addr + i, 4);
+          WRITE_WORD(addr + i, value);
+        } else {
+          MEM_READ_HOOK(addr + i, 4);
+          value = READ_WORD(addr + i);
+          memcpy(v + i, &value, 4);
+        }
+      }
+    }
+    for (; i < bytes; i++) {
+      if (store) {
+        MEM_WRITE_HOOK(addr + i, 1);
+        WRITE_BYTE(addr + i, v[i]);
+      } else {
+        MEM_READ_HOOK(addr + i, 1);
+        v[i] = READ_BYTE(addr + i);
+      }
+    }
+    return;
+  }
+
+  for (uint32_t i = 0; i < n; i++, addr += stride) {
+    if (!riscv_rvv::active(mask, i))
+      continue;
+    value = 0;
+    if (store) {
+      memcpy(&value, v + i * size, size);
+      MEM_WRITE_HOOK(addr, size);
+      if (size == 1)
+        WRITE_BYTE(addr, value);
+      else if (size == 2)
+        WRITE_HALF(addr, value);
+      else
+        WRITE_WORD(addr, value);
+    } else {
+      MEM_READ_HOOK(addr, size);
+      value = size == 1 ? READ_BYTE(addr)
+              : size == 2 ? READ_HALF(addr) : READ_WORD(addr);
+      memcpy(v + i * size, &value, size);
+    }
+  }
+}
+
+// Fill the CSR table, once per process
+void riscv_isa::csr_init() {
+  csr_table &table = csr_table::instance();
+  if (table.ready())
+    return;
+  table.add(RISCV_CSR_FFLAGS, &riscv_isa::csr_read_fp, &riscv_isa::csr_write_fp);
+  table.add(RISCV_CSR_FRM, &riscv_isa::csr_read_fp, &riscv_isa::csr_write_fp);
+  table.add(RISCV_CSR_FCSR, &riscv_isa::csr_read_fp, &riscv_isa::csr_write_fp);
+  table.add(RISCV_CSR_VL, &riscv_isa::csr_read_vector);
+  table.add(RISCV_CSR_VTYPE, &riscv_isa::csr_read_vector);
+  table.add(RISCV_CSR_VLENB, &riscv_isa::csr_read_vector);
+  table.add(RISCV_CSR_MISA, &riscv_isa::csr_read_machine,
+            &riscv_isa::csr_write_machine);
+  table.add(RISCV_CSR_MSCRATCH, &riscv_isa::csr_read_machine,
+            &riscv_isa::csr_write_machine);
+  table.add(RISCV_CSR_MSTATUS, &riscv_isa::csr_read_trap,
+            &riscv_isa::csr_write_trap);
+  table.add(RISCV_CSR_MTVEC, &riscv_isa::csr_read_trap,
+            &riscv_isa::csr_write_trap);
+  table.add(RISCV_CSR_MEPC, &riscv_isa::csr_read_trap,
+            &riscv_isa::csr_write_trap);
+  table.add(RISCV_CSR_MCAUSE, &riscv_isa::csr_read_trap,
+            &riscv_isa::csr_write_trap);
+  table.add(RISCV_CSR_MTVAL, &riscv_isa::csr_read_trap,
+            &riscv_isa::csr_write_trap);
+  table.add(RISCV_CSR_MIE, &riscv_isa::csr_read_trap,
+            &riscv_isa::csr_write_trap);
+  table.add(RISCV_CSR_MIP, &riscv_isa::csr_read_trap,
+            &riscv_isa::csr_write_trap);
+  if (XLEN == 32)
+    table.add(RISCV_CSR_MSTATUSH, &riscv_isa::csr_read_trap,
+              &riscv_isa::csr_write_trap);
+  table.add(RISCV_CSR_MVENDORID, &riscv_isa::csr_read_machine);
+  table.add(RISCV_CSR_MARCHID, &riscv_isa::csr_read_machine);
+  table.add(RISCV_CSR_MIMPID, &riscv_isa::csr_read_machine);
+  table.add(RISCV_CSR_MHARTID, &riscv_isa::csr_read_machine);
+  for (unsigned counter = 0; counter < 3; counter++) {
+    table.add(RISCV_CSR_CYCLE + counter, &riscv_isa::csr_read_counter);
+    if (XLEN == 32)
+      table.add(RISCV_CSR_CYCLEH + counter, &riscv_isa::csr_read_counter);
+  }
+  for (unsigned counter = 0; counter < 3; counter += 2) {
+    table.add(RISCV_CSR_MCYCLE + counter, &riscv_isa::csr_read_counter,
+              &riscv_isa::csr_write_counter);
+    if (XLEN == 32)
+      table.add(RISCV_CSR_MCYCLEH + counter, &riscv_isa::csr_read_counter,
+                &riscv_isa::csr_write_counter);
+  }
+  for (unsigned counter = 0; counter < 29; counter++) {
+    table.add(RISCV_CSR_MHPMEVENT3 + counter, &riscv_isa::csr_read_hpmevent,
+              &riscv_isa::csr_write_hpmevent);
+    table.add(RISCV_CSR_MHPMCOUNTER3 + counter, &riscv_isa::csr_read_hpm,
+              &riscv_isa::csr_write_hpm);
+    table.add(RISCV_CSR_HPMCOUNTER3 + counter, &riscv_isa::csr_read_hpm);
+    if (XLEN == 32) {
+      table.add(RISCV_CSR_MHPMCOUNTER3H + counter, &riscv_isa::csr_read_hpm,
+                &riscv_isa::csr_write_hpm);
+      table.add(RISCV_CSR_HPMCOUNTER3H + counter, &riscv_isa::csr_read_hpm);
+    }
+  }
+}
+
+// CSRRW/CSRRS/CSRRC[I]. CSRRW with rd x0 does not read the CSR, CSRRS
+// and CSRRC with x0 or a zero immediate (`write` false) do not write it,
+// so neither side effect happens.
+void riscv_isa::csr_execute(unsigned csr, unsigned rd, int op,
+                            ac_word operand, bool write) {
+  const csr_table &table = csr_table::instance();
+  const csr_table::entry &e = table[csr];
+  if (!table.allowed(csr, write, priv)) {
+    csr_illegal(csr);
+    return;
+  }
+
+  ac_word old = 0;
+  if (rd != 0 || op != RISCV_CSR_RW)
+    old = (this->*e.read)(csr);
+  if (write) {
+    ac_word value = op == RISCV_CSR_RW ? operand
+                    : op == RISCV_CSR_RS ? old | operand : old & ~operand;
+    (this->*e.write)(csr, value);
+  }
+  if (rd != 0)
+    RB[rd] = old;
+  dbg_printf("CSR %#x: %#llx\n", csr, (unsigned long long)old);
+  if (write)
+    IRQ_CHECK();
+}
+
+void riscv_isa::csr_illegal(unsigned csr) {
+  if (trap(RISCV_CAUSE_ILLEGAL_INSN, 0))
+    return;
+  fprintf(stderr, "Hart %d: illegal access to CSR %#x at pc %#x\n", hartid,
+          csr, (uint32_t)ac_pc - 4);
+  stop();
+}
+
+// fflags, frm and fcsr. fcsr is frm << 5 | fflags, the three views stay
+// in sync; exceptions still pending in the host FPU are folded in first.
+ac_word riscv_isa::csr_read_fp(unsigned csr) {
+  FFLAGS_SYNC();
+  switch (csr) {
+  case RISCV_CSR_FFLAGS: return fflags;
+  case RISCV_CSR_FRM:    return frm;
+  default:               return fcsr;
+  }
+}
+
+void riscv_isa::csr_write_fp(unsigned csr, ac_word value) {
+  FFLAGS_SYNC();
+  switch (csr) {
+  case RISCV_CSR_FFLAGS:
+    fflags = value & 0x1f;
+    break;
+  case RISCV_CSR_FRM:
+    frm = value & 0x7;
+    break;
+  default:
+    fflags = value & 0x1f;
+    frm = (value >> 5) & 0x7;
+    break;
+  }
+  fcsr = (frm << 5) | fflags;
+}
+
+// vl, vtype and vlenb, written by vsetvl* only
+ac_word riscv_isa::csr_read_vector(unsigned csr) {
+  switch (csr) {
+  case RISCV_CSR_VL:    return vl;
+  case RISCV_CSR_VTYPE: return vtype;
+  default:              return vlenb;
+  }
+}
+
+// Machine information and scratch CSRs. misa reports MXL and IMAFDC and
+// ignores writes (WARL); there is no vendor, architecture or
+// implementation ID.
+ac_word riscv_isa::csr_read_machine(unsigned csr) {
+  switch (csr) {
+  case RISCV_CSR_MISA: {
+    const ac_word extensions = 1 << 0 | 1 << 2 | 1 << 3 | 1 << 5 |  // A C D F
+                               1 << 8 | 1 << 12 | 1 << 20;        // I M U
+    return (ac_word)(XLEN == 64 ? 2 : 1) << (XLEN - 2) | extensions;
+  }
+  case RISCV_CSR_MSCRATCH: return mscratch;
+  case RISCV_CSR_MHARTID:  return mhartid;
+  default:                 return 0;
+  }
+}
+
+void riscv_isa::csr_write_machine(unsigned csr, ac_word value) {
+  if (csr == RISCV_CSR_MSCRATCH)
+    mscratch = value;
+}
+
+// mstatus, mtvec, mepc, mcause, mtval, mie, mip and on RV32 mstatush.
+// Of mstatus only MIE, MPIE and MPP (M or U) are writable, FS and VS
+// read as dirty and RV64 reports UXL 64. mie and mip hold the machine
+// software, timer and external interrupt bits; mip is read-only, the
+// sources set it.
+ac_word riscv_isa::csr_read_trap(unsigned csr) {
+  switch (csr) {
+  case RISCV_CSR_MSTATUS: {
+    ac_word status = (ac_word)mstatus | RISCV_MSTATUS_FS | RISCV_MSTATUS_VS;
+    if (XLEN == 64)
+      status |= (ac_word)2 << (XLEN - 32);        // UXL, bits 33:32
+    return status | (ac_word)1 << (XLEN - 1);     // SD
+  }
+  case RISCV_CSR_MTVEC:  return mtvec;
+  case RISCV_CSR_MEPC:   return mepc;
+  case RISCV_CSR_MCAUSE: return mcause;
+  case RISCV_CSR_MTVAL:  return mtval;
+  case RISCV_CSR_MIE:    return mie;
+  case RISCV_CSR_MIP:    irq_update(); return mip;
+  default:               return 0;
+  }
+}
+
+void riscv_isa::csr_write_trap(unsigned csr, ac_word value) {
+  const ac_word irqs = 1 << RISCV_IRQ_MSI | 1 << RISCV_IRQ_MTI |
+                       1 << RISCV_IRQ_MEI;
+  switch (csr) {
+  case RISCV_CSR_MSTATUS:
+    value &= RISCV_MSTATUS_MIE | RISCV_MSTATUS_MPIE | RISCV_MSTATUS_MPP;
+    if ((value & RISCV_MSTATUS_MPP) != RISCV_MSTATUS_MPP)
+      value &= ~(ac_word)RISCV_MSTATUS_MPP;       // S is not implemented
+    mstatus = value;
+    break;
+  case RISCV_CSR_MTVEC:  mtvec = value & ~(ac_word)2; break;   // modes 0, 1
+  case RISCV_CSR_MEPC:   mepc = value & ~(ac_word)1; break;
+  case RISCV_CSR_MCAUSE: mcause = value; break;
+  case RISCV_CSR_MTVAL:  mtval = value; break;
+  case RISCV_CSR_MIE:    mie = value & irqs; break;
+  default:               break;
+  }
+  irq_update();
+}
+
+// Synchronous exception of the instruction at ac_pc - 4
+bool riscv_isa::trap(unsigned cause, ac_word tval) {
+  if ((ac_word)mtvec == 0)
+    return false;
+  dbg_printf("Trap %u at pc %#x, tval %#llx\n", cause, (uint32_t)ac_pc - 4,
+             (unsigned long long)tval);
+  trap_enter(cause, tval, ac_pc - 4, mtvec & ~(ac_word)3);
+  return true;
+}
+
+// Highest priority pending and enabled interrupt, taken before the
+// instruction at ac_pc. Vectored mode jumps to base + 4 * cause.
+void riscv_isa::interrupt() {
+  irq_update();
+  if (irq_at != 0)
+    return;
+  ac_word pending = (ac_word)mip & (ac_word)mie;
+  unsigned code = pending & (1 << RISCV_IRQ_MEI)   ? RISCV_IRQ_MEI
+                  : pending & (1 << RISCV_IRQ_MSI) ? RISCV_IRQ_MSI
+                                                   : RISCV_IRQ_MTI;
+  ac_word target = mtvec & ~(ac_word)3;
+  if (mtvec & 1)
+    target += 4 * code;
+  dbg_printf("Interrupt %u at pc %#x\n", code, (uint32_t)ac_pc);
+  trap_enter((ac_word)1 << (XLEN - 1) | code, 0, ac_pc, target);
+}
+
+// Save the state to mepc/mcause/mtval/mstatus and go to M-mode at target
+void riscv_isa::trap_enter(ac_word cause, ac_word tval, ac_word epc,
+                           ac_word target) {
+  ac_word status = mstatus;
+  status &= ~(ac_word)(RISCV_MSTATUS_MIE | RISCV_MSTATUS_MPIE |
+                       RISCV_MSTATUS_MPP);
+  if (mstatus & RISCV_MSTATUS_MIE)
+    status |= RISCV_MSTATUS_MPIE;
+  mstatus = status | (ac_word)priv << 11;
+  mepc = epc;
+  mcause = cause;
+  mtval = tval;
+  priv = RISCV_PRIV_M;
+  lr_valid = false;
+  ac_pc = target;
+  irq_update();
+}
+
+// M-mode interrupts are enabled below M and with mstatus.MIE in M.
+// mip.MTIP follows the timer: set from the cycle mtime reaches mtimecmp.
+void riscv_isa::irq_update() {
+  const ac_word mtip = 1 << RISCV_IRQ_MTI;
+  uint64_t now = cycles();
+  if (mtime() >= mtimecmp)
+    timer_at = now;
+  else
+    timer_at = riscv_clock::instance().cycles_at(mtimecmp - time_offset);
+  mip = ((ac_word)mip & ~mtip) | (timer_at <= now ? mtip : 0);
+
+  bool enabled = priv < RISCV_PRIV_M || (mstatus & RISCV_MSTATUS_MIE);
+  if (!enabled)
+    irq_at = ~0ULL;
+  else if ((ac_word)mip & (ac_word)mie)
+    irq_at = 0;
+  else if ((ac_word)mie & mtip)
+    irq_at = timer_at;
+  else
+    irq_at = ~0ULL;
+}
+
+uint64_t riscv_isa::mtime() {
+  return riscv_clock::instance().time(cycles()) + time_offset;
+}
+
+// CLINT registers of this hart; the other harts' msip and mtimecmp
+// read as 0 and ignore writes. msip is a 4-byte register; 4-byte
+// accesses to the 8-byte mtime and mtimecmp see one half.
+uint64_t riscv_isa::clint_read(ac_word addr, unsigned size) {
+  uint32_t offset = addr - RISCV_CLINT_BASE;
+  uint64_t value = 0;
+  if (offset == RISCV_CLINT_MSIP + 4 * (uint32_t)hartid)
+    return msip;
+  if ((offset & ~7) == RISCV_CLINT_MTIMECMP + 8 * (uint32_t)hartid)
+    value = mtimecmp;
+  else if ((offset & ~7) == RISCV_CLINT_MTIME)
+    value = mtime();
+  if (size == 4)
+    value >>= 8 * (offset & 4);
+  return value;
+}
+
+void riscv_isa::clint_write(ac_word addr, uint64_t value, unsigned size) {
+  uint32_t offset = addr - RISCV_CLINT_BASE;
+  if (offset == RISCV_CLINT_MSIP + 4 * (uint32_t)hartid) {
+    msip = value & 1;
+    mip = ((ac_word)mip & ~(ac_word)(1 << RISCV_IRQ_MSI)) |
+          (ac_word)msip << RISCV_IRQ_MSI;
+    irq_update();
+    return;
+  }
+
+  uint32_t shift = 8 * (offset & 4);
+  uint64_t mask = size == 4 ? 0xFFFFFFFFULL << shift : ~0ULL;
+  value = size == 4 ? value << shift : value;
+  if ((offset & ~7) == RISCV_CLINT_MTIMECMP + 8 * (uint32_t)hartid) {
+    mtimecmp = (mtimecmp & ~mask) | (value & mask);
+  } else if ((offset & ~7) == RISCV_CLINT_MTIME) {
+    uint64_t now = mtime();
+    time_offset += ((now & ~mask) | (value & mask)) - now;
+  } else {
+    return;
+  }
+  irq_update();
+}
+
+// cycle, time and instret, their M-mode views mcycle and minstret, and
+// on RV32 the high halves. The low bits of the address select the
+// counter; bit 7 the high half.
+ac_word riscv_isa::csr_read_counter(unsigned csr) {
+  uint64_t value;
+  switch (csr & 3) {
+  case 0:  value = cycles(); break;
+  case 1:  value = mtime(); break;
+  default: value = instret(); break;
+  }
+  return (csr & 0x80) ? (ac_word)(value >> 32) : (ac_word)value;
+}
+
+// Writes move the counter by adjusting its offset
+void riscv_isa::csr_write_counter(unsigned csr, ac_word value) {
+  uint64_t current = (csr & 3) == 0 ? cycles() : instret(), next;
+  if (csr & 0x80)
+    next = (current & 0xFFFFFFFFULL) | (uint64_t)value << 32;
+  else if (XLEN == 32)
+    next = (current & ~0xFFFFFFFFULL) | (uint32_t)value;
+  else
+    next = value;
+  if ((csr & 3) == 0)
+    cycle_offset += next - current;
+  else
+    instret_offset += next - current;
+  irq_update();
+}
+
+// Raw count of a performance monitor event
+uint64_t riscv_isa::hpm_total(unsigned event) {
+  switch (event) {
+  case HPM_NONE:
+    return 0;
+  case HPM_SYSCALLS: {
+    riscv_syscall *sys =
+        riscv_syscall::local(hartid - riscv_shm::instance().hart_base());
+    return hpm_count[HPM_SYSCALLS] + (sys ? sys->syscalls : 0);
+  }
+  case HPM_CACHE_MISSES:
+#ifdef RISCV_COHERENCE
+    return riscv_coherence::instance().misses(hartid);
+#else
+    return 0;
+#endif
+  default:
+    return hpm_count[event];
+  }
+}
+
+// mhpmcounter3-31, hpmcounter3-31 and their high halves; the counter
+// number is csr[4:0]. Writes move the offset like mcycle's.
+ac_word riscv_isa::csr_read_hpm(unsigned csr) {
+  unsigned n = csr & 0x1F;
+  uint64_t value = hpm_total(hpm_event[n]) + hpm_offset[n];
+  return (csr & 0x80) ? (ac_word)(value >> 32) : (ac_word)value;
+}
+
+void riscv_isa::csr_write_hpm(unsigned csr, ac_word value) {
+  unsigned n = csr & 0x1F;
+  uint64_t total = hpm_total(hpm_event[n]);
+  uint64_t current = total + hpm_offset[n], next;
+  if (csr & 0x80)
+    next = (current & 0xFFFFFFFFULL) | (uint64_t)value << 32;
+  else if (XLEN == 32)
+    next = (current & ~0xFFFFFFFFULL) | (uint32_t)value;
+  else
+    next = value;
+  hpm_offset[n] = next - total;
+}
+
+ac_word riscv_isa::csr_read_hpmevent(unsigned csr) {
+  return hpm_event[csr & 0x1F];
+}
+
+// Selecting an event keeps the counter value; events outside HPM_*
+// read back as HPM_NONE
+void riscv_isa::csr_write_hpmevent(unsigned csr, ac_word value) {
+  unsigned n = csr & 0x1F;
+  unsigned event = value < HPM_EVENTS ? (unsigned)value : HPM_NONE;
+  uint64_t current = hpm_total(hpm_event[n]) + hpm_offset[n];
+  hpm_event[n] = event;
+  hpm_offset[n] = current - hpm_total(event);
+  hpm_mask = 0;
+  for (unsigned i = 3; i < 32; i++)
+    hpm_mask |= 1u << hpm_event[i];
+  hpm_mask &= ~(1u << HPM_NONE);
+}
 
 // Generic instruction behavior method
 void ac_behavior(instruction) {
@@ -48,27 +1723,95 @@ void ac_behavior(Type_S) {}
 void ac_behavior(Type_SB) {}
 void ac_behavior(Type_U) {}
 void ac_behavior(Type_UJ) {}
+void ac_behavior(Type_C) {}
+void ac_behavior(Type_V) {}
+void ac_behavior(Type_VSET) {}
+void ac_behavior(Type_VM) {}
+void ac_behavior(Type_SH) {}
 
 
 // Behavior called before starting simulation
 void ac_behavior(begin) {
   dbg_printf("@@@ begin behavior @@@\n");
+  riscv_shm &shm = riscv_shm::instance();
+  shm.start(DM, AC_RAM_END);
+  shm_mem = shm.mem;
+  shm_base = shm.base;
+  shm_size = shm.size;
+  lr_valid = false;
+  hartid = shm.hart_base() + processors_started++;
+  processors_running++;
+  mhartid = hartid;
+  mscratch = 0;
+  mstatus = mtvec = mepc = mcause = mtval = mie = mip = 0;
+  time_offset = 0;
+  mtimecmp = timer_at = irq_at = ~0ULL;
+  msip = 0;
+  cycle_offset = instret_offset = 0;
+  hpm_mask = 0;
+  memset(hpm_event, 0, sizeof(hpm_event));
+  memset(hpm_offset, 0, sizeof(hpm_offset));
+  memset(hpm_count, 0, sizeof(hpm_count));
+  priv = RISCV_PRIV_M;
+  csr_init();
+  riscv_hart_layout layout = riscv_layout(hartid, AC_RAM_END);
+  guard_lo = layout.guard_lo;
+  guard_size = layout.guard_size;
+  spin_pc = spin_iter = 0;
+  spin_stores = store_count = spin_load = 0;
+  spin_vectors = vector_count = 0;
+  spin_loaded = false;
+  idle_skipped = 0;
+#ifdef RISCV_COHERENCE
+  riscv_coherence::instance().hart_begin(hartid);
+#endif
 
   for (int regNum = 0; regNum < 32; regNum++)
     {
       RB[regNum] = 0;
       RBF[regNum] = 0;
-      RBF[regNum+32] = 0;
     }
     fcsr = 0;
     frm = 0;
     fflags = 0;
+    fp_pending = 0;
+    vregs = (uint8_t *)calloc(32, RVV_VLENB);
+    vl = 0;
+    vtype = (ac_word)1 << (XLEN - 1);   // vill until the first vsetvl
+    vlenb = RVV_VLENB;
+
+    const char *backend = getenv("RISCV_FP");
+    fp_backend = FP_HOST;
+    if (backend && !strcmp(backend, "soft"))
+      fp_backend = FP_SOFT;
+    else if (backend && !strcmp(backend, "check"))
+      fp_backend = FP_CHECK;
 }
 
 
 // Behavior called after finishing simulation
 void ac_behavior(end) {
   dbg_printf("@@@ end behavior @@@\n");
+  if (idle_skipped)
+    fprintf(stderr, "Hart %d: %llu idle instructions skipped\n", hartid,
+            (unsigned long long)idle_skipped);
+#ifdef RISCV_COHERENCE
+  riscv_coherence::instance().hart_end();
+#endif
+  if (fp_owner == &fp_pending)
+    fp_owner = 0;
+  if (--processors_running == 0) {
+    riscv_shm::instance().finish();
+    if (host_rm)
+      set_host_rounding(0);
+    if (fp_mismatches)
+      fprintf(stderr, "FP check: %llu host results differ from soft-float\n",
+              (unsigned long long)fp_mismatches);
+    riscv_hle::instance().report();
+#ifdef RISCV_FP_PROFILE
+    riscv_fpprof::instance().report(stderr);
+#endif
+  }
 }
 
 // Instruction ADD behavior method. (no check for overflow)
@@ -92,7 +1835,7 @@ void ac_behavior(SUB) {
 // Instruction SLL behavior method.
 void ac_behavior(SLL) {
   dbg_printf("SLL r%d, r%d, r%d\n", rd, rs1, rs2);
-  RB[rd] = RB[rs1] << RB[rs2];
+  RB[rd] = RB[rs1] << (RB[rs2] & (XLEN - 1));
   dbg_printf("RB[rs1] = %d\n", RB[rs1]);
   dbg_printf("RB[rs2] = %d\n", RB[rs2]);
   dbg_printf("Result = %d\n\n", RB[rd]);
@@ -134,7 +1877,7 @@ void ac_behavior(XOR) {
 // Instruction SRL behavior method.
 void ac_behavior(SRL) {
   dbg_printf("SRL r%d, r%d, r%d\n", rd, rs1, rs2);
-  RB[rd] = RB[rs1] >> RB[rs2];
+  RB[rd] = RB[rs1] >> (RB[rs2] & (XLEN - 1));
   dbg_printf("RB[rs1] = %d\n", RB[rs1]);
   dbg_printf("RB[rs2] = %d\n", RB[rs2]);
   dbg_printf("Result = %d\n\n", RB[rd]);
@@ -143,7 +1886,7 @@ void ac_behavior(SRL) {
 // Instruction SRA behavior method.
 void ac_behavior(SRA) {
   dbg_printf("SRA r%d, r%d, r%d\n", rd, rs1, rs2);
-  RB[rd] = ((ac_Sword)RB[rs1]) >> RB[rs2];
+  RB[rd] = ((ac_Sword)RB[rs1]) >> (RB[rs2] & (XLEN - 1));
   dbg_printf("RB[rs1] = %d\n", RB[rs1]);
   dbg_printf("RB[rs2] = %d\n", RB[rs2]);
   dbg_printf("Result = %d\n\n", RB[rd]);
@@ -175,7 +1918,8 @@ void ac_behavior(LB) {
   dbg_printf("LB r%d, r%d, %d\n", rd, rs1, offset);
   int sign_ext;
   sign_ext = sign_extend(offset, 12);
-  byte = DM.read_byte(RB[rs1] + sign_ext);
+  MEM_READ_HOOK(RB[rs1] + sign_ext, 1);
+  byte = READ_BYTE(RB[rs1] + sign_ext);
   RB[rd] = sign_extend(byte, 8);
   dbg_printf("RB[rs1] = %#x, byte = %#x\n", RB[rs1], byte);
   dbg_printf("addr = %#x\n", RB[rs1] + sign_ext);
@@ -190,7 +1934,9 @@ void ac_behavior(LH) {
   dbg_printf("LH r%d, r%d, %d\n", rd, rs1, offset);
   int sign_ext;
   sign_ext = sign_extend(offset, 12);
-  half = DM.read_half(RB[rs1] + sign_ext);
+  LOAD_ALIGN(RB[rs1] + sign_ext, 2);
+  MEM_READ_HOOK(RB[rs1] + sign_ext, 2);
+  half = READ_HALF(RB[rs1] + sign_ext);
   RB[rd] = sign_extend(half, 16);
   dbg_printf("RB[rs1] = %#x, half = %#x\n", RB[rs1], half);
   dbg_printf("addr = %#x\n", RB[rs1] + sign_ext);
@@ -204,7 +1950,9 @@ void ac_behavior(LW) {
   dbg_printf("LW r%d, r%d, %d\n", rd, rs1, offset);
   int sign_ext;
   sign_ext = sign_extend(offset, 12);
-  RB[rd] = DM.read(RB[rs1] + sign_ext);
+  LOAD_ALIGN(RB[rs1] + sign_ext, 4);
+  MEM_READ_HOOK(RB[rs1] + sign_ext, 4);
+  RB[rd] = (int32_t)READ_WORD(RB[rs1] + sign_ext);
   dbg_printf("RB[rs1] = %#x\n", RB[rs1]);
   dbg_printf("addr = %#x\n", RB[rs1] + sign_ext);
   dbg_printf("Result = %#x\n\n", RB[rd]);
@@ -217,7 +1965,8 @@ void ac_behavior(LBU) {
   dbg_printf("LBU r%d, r%d, %d\n", rd, rs1, offset);
   int sign_ext;
   sign_ext = sign_extend(offset, 12);
-  RB[rd] = DM.read_byte(RB[rs1] + sign_ext);
+  MEM_READ_HOOK(RB[rs1] + sign_ext, 1);
+  RB[rd] = READ_BYTE(RB[rs1] + sign_ext);
   dbg_printf("RB[rs1] = %#x\n", RB[rs1]);
   dbg_printf("addr = %#x\n", RB[rs1] + sign_ext);
   dbg_printf("Result = %#x\n\n", RB[rd]);
@@ -230,7 +1979,9 @@ void ac_behavior(LHU) {
   dbg_printf("LHU r%d, r%d, %d\n", rd, rs1, offset);
   int sign_ext;
   sign_ext = sign_extend(offset, 12);
-  RB[rd] = DM.read_half(RB[rs1] + sign_ext);
+  LOAD_ALIGN(RB[rs1] + sign_ext, 2);
+  MEM_READ_HOOK(RB[rs1] + sign_ext, 2);
+  RB[rd] = READ_HALF(RB[rs1] + sign_ext);
   dbg_printf("RB[rs1] = %#x\n", RB[rs1]);
   dbg_printf("addr = %#x\n", RB[rs1] + sign_ext);
   dbg_printf("Result = %#x\n\n", RB[rd]);
@@ -262,7 +2013,7 @@ void ac_behavior(SLTI) {
   dbg_printf("SLTI r%d, r%d, %d\n", rd, rs1, imm);
   int sign_ext;
   sign_ext = sign_extend(imm, 12);
-  if (RB[rs1] < sign_ext)
+  if ((ac_Sword)RB[rs1] < sign_ext)
     RB[rd] = 1;
   else
     RB[rd] = 0;
@@ -320,28 +2071,31 @@ void ac_behavior(ANDI) {
 
 // Instruction JALR behavior method.
 void ac_behavior(JALR) {
-  int target_addr;
+  ac_word target_addr;
   int imm;
   imm = (imm4 << 11) | (imm3 << 5) | (imm2 << 1) | imm1;
   dbg_printf("JALR r%d, r%d, %d\n", rd, rs1, imm);
   int sign_ext;
   sign_ext = sign_extend(imm, 12);
-  target_addr = RB[rs1] + sign_ext;
-  target_addr = target_addr >> 1;
-  target_addr = target_addr << 1;
+  target_addr = (RB[rs1] + sign_ext) & ~(ac_word)1;
   if (rd != 0)
     RB[rd] = ac_pc;
   ac_pc = target_addr;
-  dbg_printf("Target = %#x\n", (ac_pc & 0xF0000000) | target_addr);
+  if (ac_pc == riscv_forksrv_target() && ac_pc != 0)
+    riscv_forksrv_run();
+  HLE_JUMP();
+  IRQ_CHECK();
   dbg_printf("Target = %#x\n", target_addr);
   dbg_printf("Return = %#x\n\n", RB[rd]);
 }
 
-// Instruction SLLI behavior method.
+// Instruction SLLI behavior method. shamt[5] is reserved on RV32.
 void ac_behavior(SLLI) {
-  short int shamt;
-  shamt = (imm2 << 1) | imm1;
   dbg_printf("SLLI r%d, r%d, %d\n", rd, rs1, shamt);
+  if (shamt >= XLEN) {
+    xlen_illegal();
+    return;
+  }
   RB[rd] = RB[rs1] << shamt;
   dbg_printf("shamt = %d\n", shamt);
   dbg_printf("Result = %#x\n\n", RB[rd]);
@@ -349,9 +2103,11 @@ void ac_behavior(SLLI) {
 
 // Instruction SRLI behavior method.
 void ac_behavior(SRLI) {
-  short int shamt;
-  shamt = (imm2 << 1) | imm1;
   dbg_printf("SRLI r%d, r%d, %d\n", rd, rs1, shamt);
+  if (shamt >= XLEN) {
+    xlen_illegal();
+    return;
+  }
   RB[rd] = RB[rs1] >> shamt;
   dbg_printf("shamt = %d\n", shamt);
   dbg_printf("Result = %#x\n\n", RB[rd]);
@@ -359,13 +2115,12 @@ void ac_behavior(SRLI) {
 
 // Instruction SRAI behavior method.
 void ac_behavior(SRAI) {
-  short int shamt;
-  shamt = (imm2 << 1) | imm1;
   dbg_printf("SRAI r%d, r%d, %d\n", rd, rs1, shamt);
-  if ((RB[rs1] >> 31) == 1)
-    RB[rd] = (RB[rs1] >> shamt) | (0xFFFFFFFF << (32 - shamt));
-  else
-    RB[rd] = RB[rs1] >> shamt;
+  if (shamt >= XLEN) {
+    xlen_illegal();
+    return;
+  }
+  RB[rd] = (ac_Sword)RB[rs1] >> shamt;
   dbg_printf("shamt = %d\n", shamt);
   dbg_printf("Result = %#x\n\n", RB[rd]);
 }
@@ -373,6 +2128,9 @@ void ac_behavior(SRAI) {
 // Instruction SCALL behavior method.
 void ac_behavior(SCALL) {
   dbg_printf("SCALL\n");
+  HPM_COUNT(HPM_SYSCALLS);
+  if (trap(RISCV_CAUSE_ECALL_U + priv, 0))
+    return;
   printf("System Call\n\n");
   stop();
 }
@@ -380,65 +2138,95 @@ void ac_behavior(SCALL) {
 // Instruction SBREAK behavior method.
 void ac_behavior(SBREAK) {
   dbg_printf("SBREAK\n");
+  if (trap(RISCV_CAUSE_BREAKPOINT, ac_pc - 4))
+    return;
   printf("Breakpoint\n\n");
   stop();
 }
 
-// Instruction RDCYCLE behavior method.
-void ac_behavior(RDCYCLE) {
-  dbg_printf("RDCYCLE r%d\n", rd);
-  RB[rd] = ac_pc;
-  dbg_printf("Result = %#x\n", RB[rd]);
+// Instruction WFI behavior method.
+void ac_behavior(WFI) {
+  dbg_printf("WFI\n");
+  irq_update();
+#ifdef RISCV_IDLE
+  // Wait for an interrupt in mip & mie, enabled or not; only the timer
+  // can raise one meanwhile
+  if (((ac_word)mip & (ac_word)mie) == 0) {
+    uint64_t wake = (ac_word)mie & (1 << RISCV_IRQ_MTI) ? timer_at : ~0ULL;
+    idle_skipped += riscv_idle::instance().park(
+        hartid, false, 0, IDLE_BUDGET(wake), processors_started);
+  }
+#endif
+  IRQ_CHECK();
 }
 
-// Instruction RDCYCLEH behavior method.
-void ac_behavior(RDCYCLEH) { dbg_printf("RDCYCLEH r%d\n", rd); }
-
-// Instruction RDTIME behavior method.
-void ac_behavior(RDTIME) { dbg_printf("RDTIME r%d\n", rd); }
-
-// Instruction RDTIMEH behavior method.
-void ac_behavior(RDTIMEH) { dbg_printf("RDTIMEH r%d\n", rd); }
-
-// Instruction RDINSTRET behavior method.
-void ac_behavior(RDINSTRET) { dbg_printf("RDINSTRET r%d\n", rd); }
-
-// Instruction RDINSTRETH behavior method.
-void ac_behavior(RDINSTRETH) { dbg_printf("RDINSTRETH r%d\n", rd); }
+// Instruction MRET behavior method: back to mepc at privilege MPP
+void ac_behavior(MRET) {
+  dbg_printf("MRET to %#x\n", (uint32_t)mepc);
+  if (priv != RISCV_PRIV_M) {
+    if (!trap(RISCV_CAUSE_ILLEGAL_INSN, 0)) {
+      fprintf(stderr, "Hart %d: MRET below M-mode at pc %#x\n", hartid,
+              (uint32_t)ac_pc - 4);
+      stop();
+    }
+    return;
+  }
+  ac_word status = mstatus;
+  priv = (status & RISCV_MSTATUS_MPP) >> 11;
+  status &= ~(ac_word)(RISCV_MSTATUS_MIE | RISCV_MSTATUS_MPP);
+  if (status & RISCV_MSTATUS_MPIE)
+    status |= RISCV_MSTATUS_MIE;
+  mstatus = status | RISCV_MSTATUS_MPIE;
+  ac_pc = mepc;
+  irq_update();
+  IRQ_CHECK();
+}
 
 // Instruction FENCE behavior method.
-void ac_behavior(FENCE) { dbg_printf("FENCE r%d\n", rd); }
+void ac_behavior(FENCE) {
+  dbg_printf("FENCE r%d\n", rd);
+  if (shm_size)
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
 
 // Instruction FENCE_I behavior method.
 void ac_behavior(FENCE_I) { dbg_printf("FENCE_I r%d\n", rd); }
 
 // Instruction CSRRW behavior method.
 void ac_behavior(CSRRW) {
- dbg_printf("CSRRW csr:%d\n", csr);
- ac_word tmp = RB[rd];
- ac_reg<riscv_parms::ac_word> mapped = csr_map(csr);
- if(rd != 0x0){
-  RB[rd] = mapped;
- }
- mapped = tmp;
+  dbg_printf("CSRRW r%d, %#x, r%d\n", rd, csr, rs1);
+  csr_execute(csr, rd, RISCV_CSR_RW, RB[rs1], true);
 }
 
 // Instruction CSRRS behavior method.
 void ac_behavior(CSRRS) {
- dbg_printf("CSRRS csr:%d\n", csr);
- ac_reg<riscv_parms::ac_word> mapped = csr_map(csr);
- ac_word tmp = RB[rd];
- RB[rd] = mapped;
- mapped |= tmp;
+  dbg_printf("CSRRS r%d, %#x, r%d\n", rd, csr, rs1);
+  csr_execute(csr, rd, RISCV_CSR_RS, RB[rs1], rs1 != 0);
 }
 
 // Instruction CSRRC behavior method.
 void ac_behavior(CSRRC) {
- dbg_printf("CSRRC csr:%d\n", csr);
- ac_reg<riscv_parms::ac_word> mapped = csr_map(csr);
- ac_word tmp = RB[rd];
- RB[rd] = mapped;
- mapped &= ~tmp;
+  dbg_printf("CSRRC r%d, %#x, r%d\n", rd, csr, rs1);
+  csr_execute(csr, rd, RISCV_CSR_RC, RB[rs1], rs1 != 0);
+}
+
+// Instruction CSRRWI behavior method. The rs1 field is a 5-bit
+// zero-extended immediate.
+void ac_behavior(CSRRWI) {
+  dbg_printf("CSRRWI r%d, %#x, %d\n", rd, csr, rs1);
+  csr_execute(csr, rd, RISCV_CSR_RW, rs1, true);
+}
+
+// Instruction CSRRSI behavior method.
+void ac_behavior(CSRRSI) {
+  dbg_printf("CSRRSI r%d, %#x, %d\n", rd, csr, rs1);
+  csr_execute(csr, rd, RISCV_CSR_RS, rs1, rs1 != 0);
+}
+
+// Instruction CSRRCI behavior method.
+void ac_behavior(CSRRCI) {
+  dbg_printf("CSRRCI r%d, %#x, %d\n", rd, csr, rs1);
+  csr_execute(csr, rd, RISCV_CSR_RC, rs1, rs1 != 0);
 }
 
 // Instruction SB behavior method
@@ -449,7 +2237,8 @@ void ac_behavior(SB) {
   unsigned char byte = RB[rs2] & 0xFF;
   int sign_ext;
   sign_ext = sign_extend(imm, 12);
-  DM.write_byte(RB[rs1] + sign_ext, byte);
+  MEM_WRITE_HOOK(RB[rs1] + sign_ext, 1);
+  WRITE_BYTE(RB[rs1] + sign_ext, byte);
   dbg_printf("addr: %#x\n", RB[rs1] + sign_ext);
   dbg_printf("Result: %#x\n\n\n", byte);
 }
@@ -462,7 +2251,9 @@ void ac_behavior(SH) {
   int sign_ext;
   sign_ext = sign_extend(imm, 12);
   unsigned short int half = RB[rs2] & 0xFFFF;
-  DM.write_half(RB[rs1] + sign_ext, half);
+  STORE_ALIGN(RB[rs1] + sign_ext, 2);
+  MEM_WRITE_HOOK(RB[rs1] + sign_ext, 2);
+  WRITE_HALF(RB[rs1] + sign_ext, half);
   dbg_printf("addr: %#x\n", RB[rs1] + sign_ext);
   dbg_printf("Result: %#x\n\n\n", half);
 }
@@ -474,7 +2265,9 @@ void ac_behavior(SW) {
   dbg_printf("SW r%d, r%d, %d\n", rs1, rs2, imm);
   int sign_ext;
   sign_ext = sign_extend(imm, 12);
-  DM.write(RB[rs1] + sign_ext, RB[rs2]);
+  STORE_ALIGN(RB[rs1] + sign_ext, 4);
+  MEM_WRITE_HOOK(RB[rs1] + sign_ext, 4);
+  WRITE_WORD(RB[rs1] + sign_ext, RB[rs2]);
   dbg_printf("addr: %d\n\n", RB[rs1] + sign_ext);
 }
 
@@ -483,13 +2276,12 @@ void ac_behavior(BEQ) {
   int imm;
   imm = (imm4 << 11) | (imm3 << 10) | (imm2 << 4) | imm1;
   dbg_printf("BEQ r%d, r%d, %d\n", rs1, rs2, imm);
-  unsigned int addr;
-  if (imm4 == 1)
-    addr = ac_pc + ((imm << 1) | 0xFFFFF000) - 4;
-  else
-    addr = ac_pc + (imm << 1) - 4;
+  ac_word addr = ac_pc - 4 + sign_extend(imm << 1, 13);
   if (RB[rs1] == RB[rs2]) {
+    HPM_COUNT(HPM_BRANCHES);
+    IDLE_BRANCH(addr);
     ac_pc = addr;
+    IRQ_CHECK();
     dbg_printf("---Branch Taken--- to %#x\n\n", addr);
   } else
     dbg_printf("---Branch not Taken---\n\n");
@@ -500,13 +2292,12 @@ void ac_behavior(BNE) {
   int imm;
   imm = (imm4 << 11) | (imm3 << 10) | (imm2 << 4) | imm1;
   dbg_printf("BNE r%d, r%d, %d\n", rs1, rs2, imm);
-  unsigned int addr;
-  if (imm4 == 1)
-    addr = ac_pc + ((imm << 1) | 0xFFFFF000) - 4;
-  else
-    addr = ac_pc + (imm << 1) - 4;
+  ac_word addr = ac_pc - 4 + sign_extend(imm << 1, 13);
   if (RB[rs1] != RB[rs2]) {
+    HPM_COUNT(HPM_BRANCHES);
+    IDLE_BRANCH(addr);
     ac_pc = addr;
+    IRQ_CHECK();
     dbg_printf("---Branch Taken---\n\n");
   } else
     dbg_printf("---Branch not Taken---\n\n");
@@ -517,17 +2308,16 @@ void ac_behavior(BLT) {
   int imm;
   imm = (imm4 << 11) | (imm3 << 10) | (imm2 << 4) | imm1;
   dbg_printf("BLT r%d, r%d, %d\n", rs1, rs2, imm);
-  unsigned int addr;
-  if (imm4 == 1)
-    addr = ac_pc + ((imm << 1) | 0xFFFFF000) - 4;
-  else
-    addr = ac_pc + (imm << 1) - 4;
+  ac_word addr = ac_pc - 4 + sign_extend(imm << 1, 13);
   dbg_printf("blt r%d, r%d, %#x\n", rs1, rs2, addr);
   dbg_printf("addr = %#x\n", addr);
   dbg_printf("rs1 = %#x\n", RB[rs1]);
   dbg_printf("rs2 = %#x\n", RB[rs2]);
   if ((ac_Sword)RB[rs1] < (ac_Sword)RB[rs2]) {
+    HPM_COUNT(HPM_BRANCHES);
+    IDLE_BRANCH(addr);
     ac_pc = addr;
+    IRQ_CHECK();
     dbg_printf("---Branch Taken---\n\n");
   } else
     dbg_printf("---Branch not Taken---\n\n");
@@ -538,13 +2328,12 @@ void ac_behavior(BGE) {
   int imm;
   imm = (imm4 << 11) | (imm3 << 10) | (imm2 << 4) | imm1;
   dbg_printf("BGE r%d, r%d, %d\n", rs1, rs2, imm);
-  unsigned int addr;
-  if (imm4 == 1)
-    addr = ac_pc + ((imm << 1) | 0xFFFFF000) - 4;
-  else
-    addr = ac_pc + (imm << 1) - 4;
+  ac_word addr = ac_pc - 4 + sign_extend(imm << 1, 13);
   if ((ac_Sword)RB[rs1] >= (ac_Sword)RB[rs2]) {
+    HPM_COUNT(HPM_BRANCHES);
+    IDLE_BRANCH(addr);
     ac_pc = addr;
+    IRQ_CHECK();
     dbg_printf("---Branch Taken---\n\n");
   } else
     dbg_printf("---Branch not Taken---\n\n");
@@ -555,13 +2344,12 @@ void ac_behavior(BLTU) {
   int imm;
   imm = (imm4 << 11) | (imm3 << 10) | (imm2 << 4) | imm1;
   dbg_printf("BLTU r%d, r%d, %d\n", rs1, rs2, imm);
-  unsigned int addr;
-  if (imm4 == 1)
-    addr = ac_pc + ((imm << 1) | 0xFFFFF000) - 4;
-  else
-    addr = ac_pc + (imm << 1) - 4;
+  ac_word addr = ac_pc - 4 + sign_extend(imm << 1, 13);
   if ((ac_Uword)RB[rs1] < (ac_Uword)RB[rs2]) {
+    HPM_COUNT(HPM_BRANCHES);
+    IDLE_BRANCH(addr);
     ac_pc = addr;
+    IRQ_CHECK();
     dbg_printf("---Branch Taken---\n\n");
   } else
     dbg_printf("---Branch not Taken---\n\n");
@@ -572,14 +2360,13 @@ void ac_behavior(BGEU) {
   int imm;
   imm = (imm4 << 11) | (imm3 << 10) | (imm2 << 4) | imm1;
   dbg_printf("BGEU r%d, r%d, %d\n", rs1, rs2, imm);
-  int addr;
-  if (imm4 == 1)
-    addr = ac_pc + ((imm << 1) | 0xFFFFF000) - 4;
-  else
-    addr = ac_pc + (imm << 1) - 4;
+  ac_word addr = ac_pc - 4 + sign_extend(imm << 1, 13);
   if (((ac_Uword)RB[rs1] > (ac_Uword)RB[rs2]) ||
       ((ac_Uword)RB[rs1] == (ac_Uword)RB[rs2])) {
+    HPM_COUNT(HPM_BRANCHES);
+    IDLE_BRANCH(addr);
     ac_pc = addr;
+    IRQ_CHECK();
     dbg_printf("---Branch Taken---\n\n");
   } else
     dbg_printf("---Branch not Taken---\n\n");
@@ -588,16 +2375,16 @@ void ac_behavior(BGEU) {
 // Instruction LUI behavior method
 void ac_behavior(LUI) {
   dbg_printf("LUI r%d, %d\n", rd, imm);
-  RB[rd] = imm << 12;
+  RB[rd] = (int32_t)(imm << 12);
   dbg_printf("Result = %#x\n\n", RB[rd]);
 }
 
 // Instruction AUIPC behavior method
 void ac_behavior(AUIPC) {
   dbg_printf("AUIPC r%d, %d\n", rd, imm);
-  unsigned int offset;
+  int32_t offset;
   offset = imm << 12;
-  RB[rd] = ac_pc + offset - 4;
+  RB[rd] = ac_pc - 4 + offset;
   dbg_printf("Result = %#x\n\n", RB[rd]);
 }
 
@@ -606,14 +2393,15 @@ void ac_behavior(JAL) {
   int imm;
   imm = (imm4 << 19) | (imm3 << 11) | (imm2 << 10) | imm1;
   dbg_printf("JAL r%d, %d\n", rd, imm);
-  int addr;
-  if (imm4 == 1)
-    addr = ac_pc + ((imm << 1) | 0xFFF00000) - 4;
-  else
-    addr = ac_pc + (imm << 1) - 4;
+  ac_word addr = ac_pc - 4 + sign_extend(imm << 1, 21);
   if (rd != 0)
     RB[rd] = ac_pc;
-  ac_pc = (ac_pc & 0xF0000000) | addr;
+  IDLE_BRANCH(addr);
+  ac_pc = addr;
+  if (ac_pc == riscv_forksrv_target() && ac_pc != 0)
+    riscv_forksrv_run();
+  HLE_JUMP();
+  IRQ_CHECK();
   dbg_printf("--- Jump taken ---\n\n");
 }
 
@@ -622,12 +2410,7 @@ void ac_behavior(MUL) {
   dbg_printf("MUL r%d, r%d, r%d\n", rd, rs1, rs2);
   dbg_printf("RB[rs1] = %d\n", RB[rs1]);
   dbg_printf("RB[rs2] = %d\n", RB[rs2]);
-  long long mult;
-  mult = (ac_Sword)RB[rs1];
-  mult *= (ac_Sword)RB[rs2];
-  int half;
-  half = mult;
-  RB[rd] = half;
+  RB[rd] = RB[rs1] * RB[rs2];
   dbg_printf("Result = %#x\n\n", RB[rd]);
 }
 
@@ -636,12 +2419,10 @@ void ac_behavior(MULH) {
   dbg_printf("MULH r%d, r%d, r%d\n", rd, rs1, rs2);
   dbg_printf("RB[rs1] = %d\n", RB[rs1]);
   dbg_printf("RB[rs2] = %d\n", RB[rs2]);
-  long long mult;
-  int half;
+  ac_Swide mult;
   mult = (ac_Sword)RB[rs1];
   mult *= (ac_Sword)RB[rs2];
-  half = mult >> 32;
-  RB[rd] = half;
+  RB[rd] = (ac_word)(mult >> XLEN);
   dbg_printf("Result = %#x\n\n", RB[rd]);
 }
 
@@ -650,12 +2431,10 @@ void ac_behavior(MULHSU) {
   dbg_printf("MULHSU r%d, r%d, r%d\n", rd, rs1, rs2);
   dbg_printf("RB[rs1] = %d\n", RB[rs1]);
   dbg_printf("RB[rs2] = %d\n", RB[rs2]);
-  long long mult;
-  int half;
-  mult = RB[rs1];
+  ac_Swide mult;
+  mult = (ac_Sword)RB[rs1];
   mult *= (ac_Uword)RB[rs2];
-  half = mult >> 32;
-  RB[rd] = half;
+  RB[rd] = (ac_word)(mult >> XLEN);
   dbg_printf("Result = %#x\n\n", RB[rd]);
 }
 
@@ -664,24 +2443,23 @@ void ac_behavior(MULHU) {
   dbg_printf("MULHU r%d, r%d, r%d\n", rd, rs1, rs2);
   dbg_printf("RB[rs1] = %d\n", RB[rs1]);
   dbg_printf("RB[rs2] = %d\n", RB[rs2]);
-  unsigned long long mult;
-  unsigned int half;
+  ac_Uwide mult;
   mult = (ac_Uword)RB[rs1];
   mult *= (ac_Uword)RB[rs2];
-  half = mult >> 32;
-  RB[rd] = half;
+  RB[rd] = (ac_word)(mult >> XLEN);
   dbg_printf("Result = %d\n\n", RB[rd]);
 }
 
-// Instruction DIV behavior method
+// Instruction DIV behavior method. The most negative value divided by
+// -1 overflows back to itself.
 void ac_behavior(DIV) {
   dbg_printf("DIV r%d, r%d, r%d\n", rd, rs1, rs2);
   dbg_printf("rs1 = %d\n", RB[rs1]);
   dbg_printf("rs2 = %d\n", RB[rs2]);
   if (RB[rs2] == 0)
     RB[rd] = -1;
-  else if ((RB[rs1] == ((-2) ^ 31)) && (RB[rs2] == -1))
-    RB[rd] = ((-2) ^ 31);
+  else if ((ac_Sword)RB[rs2] == -1)
+    RB[rd] = -RB[rs1];
   else
     RB[rd] = (ac_Sword)RB[rs1] / (ac_Sword)RB[rs2];
   dbg_printf("Result = %d\n\n", RB[rd]);
@@ -694,8 +2472,6 @@ void ac_behavior(DIVU) {
   dbg_printf("RB[rs2] = %d\n", RB[rs2]);
   if (RB[rs2] == 0)
     RB[rd] = -1;
-  else if ((RB[rs1] == ((-2) ^ 31)) && (RB[rs2] == -1))
-    dbg_printf("Wrong division exception!");
   else
     RB[rd] = (ac_Uword)RB[rs1] / (ac_Uword)RB[rs2];
   dbg_printf("Result = %#x\n\n", (ac_Uword)RB[rd]);
@@ -708,10 +2484,10 @@ void ac_behavior(REM) {
   dbg_printf("RB[rs2] = %d\n", RB[rs2]);
   if (RB[rs2] == 0)
     RB[rd] = RB[rs1];
-  else if ((RB[rs1] == ((-2) ^ 31)) && (RB[rs2] == -1))
+  else if ((ac_Sword)RB[rs2] == -1)
     RB[rd] = 0;
   else
-    RB[rd] = RB[rs1] % RB[rs2];
+    RB[rd] = (ac_Sword)RB[rs1] % (ac_Sword)RB[rs2];
   dbg_printf("Result = %#x\n\n", RB[rd]);
 }
 
@@ -722,319 +2498,378 @@ void ac_behavior(REMU) {
   dbg_printf("RB[rs2] = %d\n", RB[rs2]);
   if (RB[rs2] == 0)
     RB[rd] = RB[rs1];
-  else if ((RB[rs1] == ((-2) ^ 31)) && (RB[rs2] == -1))
-    dbg_printf("Wrong division exception!");
   else
     RB[rd] = (ac_Uword)RB[rs1] % (ac_Uword)RB[rs2];
   dbg_printf("Result = %#x\n\n", (ac_Uword)RB[rd]);
 }
 
 // Instruction LR.W behavior method
-void ac_behavior(LR_W) { RB[rd] = DM.read(RB[rs1]); }
+void ac_behavior(LR_W) {
+  LOAD_ALIGN(RB[rs1], 4);
+  HPM_COUNT(HPM_AMOS);
+  MEM_READ_HOOK(RB[rs1], 4);
+  lr_addr = RB[rs1];
+  lr_valid = true;
+  if (SHM_HIT(RB[rs1]))
+    lr_value = __atomic_load_n((uint32_t *)SHM_PTR(RB[rs1]), __ATOMIC_SEQ_CST);
+  else
+    lr_value = READ_WORD(RB[rs1]);
+  RB[rd] = (int32_t)lr_value;
+}
 
 // Instruction SC.w behavior method
 void ac_behavior(SC_W) {
-  DM.write(RB[rs1], RB[rs2]);
+  STORE_ALIGN(RB[rs1], 4);
+  HPM_COUNT(HPM_AMOS);
+  // Taken before the store hook, which ends the reservation
+  bool reserved = lr_valid && lr_addr == RB[rs1];
+  MEM_WRITE_HOOK(RB[rs1], 4);
+  lr_valid = false;
+  if (SHM_HIT(RB[rs1])) {
+    // The reservation holds if the word still has the value LR saw
+    uint32_t expected = lr_value;
+    bool ok = reserved &&
+              __atomic_compare_exchange_n((uint32_t *)SHM_PTR(RB[rs1]),
+                                          &expected, (uint32_t)RB[rs2], false,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+    RB[rd] = ok ? 0 : 1;
+    return;
+  }
+  // Other harts of this process store without seeing our reservation,
+  // so the word must also still hold the value LR saw
+  if (!reserved || (uint32_t)READ_WORD(RB[rs1]) != (uint32_t)lr_value) {
+    RB[rd] = 1;
+    return;
+  }
+  WRITE_WORD(RB[rs1], RB[rs2]);
   RB[rd] = 0; // indicating success
 }
 
 // Instruction AMOSWAP.W behavior method
 void ac_behavior(AMOSWAP_W) {
   dbg_printf("AMOSWAP.W r%d, r%d, r%d\n", rd, rs1, rs2);
-  RB[rd] = DM.read(RB[rs1]);
-  dbg_printf("RB[rd] = %d\n", RB[rd]);
-  dbg_printf("RB[rs2] = %d\n", RB[rs2]);
-  int temp;
-  temp = RB[rs2];
-  RB[rs2] = RB[rd];
-  RB[rd] = temp;
-  dbg_printf("After swapping RB[rd] = %d\n\n", RB[rd]);
-  DM.write(RB[rs1], RB[rd]);
+  amo(RISCV_AMO_SWAP, false, rd, RB[rs1], RB[rs2]);
+  dbg_printf("Result = %#x\n\n", RB[rd]);
 }
 
 // Instruction AMOADD.W behavior method
 void ac_behavior(AMOADD_W) {
   dbg_printf("AMOADD.W r%d, r%d, r%d\n", rd, rs1, rs2);
-  RB[rd] = DM.read(RB[rs1]);
-  dbg_printf("RB[rd] = %d\n", RB[rd]);
-  dbg_printf("RB[rs2] = %d\n", RB[rs2]);
-  DM.write(RB[rs1], ((ac_Sword)RB[rd] + (ac_Sword)RB[rs2]));
-  dbg_printf("Result = %d\n\n", RB[rd] + RB[rs2]);
+  amo(RISCV_AMO_ADD, false, rd, RB[rs1], RB[rs2]);
+  dbg_printf("Result = %#x\n\n", RB[rd]);
 }
 
 // Instruction AMOXOR.W behavior method
 void ac_behavior(AMOXOR_W) {
   dbg_printf("AMOXOR.W r%d, r%d, r%d\n", rd, rs1, rs2);
-  RB[rd] = DM.read(RB[rs1]);
-  dbg_printf("RB[rd] = %d\n", RB[rd]);
-  dbg_printf("RB[rs2] = %d\n", RB[rs2]);
-  DM.write(RB[rs1], (RB[rd] ^ RB[rs2]));
-  dbg_printf("Result = %d\n\n", RB[rd] ^ RB[rs2]);
+  amo(RISCV_AMO_XOR, false, rd, RB[rs1], RB[rs2]);
+  dbg_printf("Result = %#x\n\n", RB[rd]);
 }
 
 // Instruction AMOAND.W behavior method
 void ac_behavior(AMOAND_W) {
   dbg_printf("AMOAND.W r%d, r%d, r%d\n", rd, rs1, rs2);
-  RB[rd] = DM.read(RB[rs1]);
-  dbg_printf("RB[rd] = %d\n", RB[rd]);
-  dbg_printf("RB[rs2] = %d\n", RB[rs2]);
-  DM.write(RB[rs1], (RB[rd] & RB[rs2]));
-  dbg_printf("Result = %d\n\n", RB[rd] & RB[rs2]);
+  amo(RISCV_AMO_AND, false, rd, RB[rs1], RB[rs2]);
+  dbg_printf("Result = %#x\n\n", RB[rd]);
 }
 
 // Instruction AMOOR.W behavior method
 void ac_behavior(AMOOR_W) {
   dbg_printf("AMOOR.W r%d, r%d, r%d\n", rd, rs1, rs2);
-  RB[rd] = DM.read(RB[rs1]);
-  dbg_printf("RB[rd] = %d\n", RB[rd]);
-  dbg_printf("RB[rs2] = %d\n", RB[rs2]);
-  DM.write(RB[rs1], (RB[rd] | RB[rs2]));
-  dbg_printf("Result = %d\n\n", RB[rd] | RB[rs2]);
+  amo(RISCV_AMO_OR, false, rd, RB[rs1], RB[rs2]);
+  dbg_printf("Result = %#x\n\n", RB[rd]);
 }
 
 // Instruction AMOMIN.W behavior method
 void ac_behavior(AMOMIN_W) {
   dbg_printf("AMOMIN.W r%d, r%d, r%d\n", rd, rs1, rs2);
-  RB[rd] = DM.read(RB[rs1]);
-  dbg_printf("RB[rd] = %d\n", RB[rd]);
-  dbg_printf("RB[rs2] = %d\n", RB[rs2]);
-  if (RB[rd] < RB[rs2])
-    DM.write(RB[rs1], RB[rd]);
-  else
-    DM.write(RB[rs1], RB[rs2]);
+  amo(RISCV_AMO_MIN, false, rd, RB[rs1], RB[rs2]);
+  dbg_printf("Result = %#x\n\n", RB[rd]);
 }
 
 // Instruction AMOMAX.W behavior method
 void ac_behavior(AMOMAX_W) {
   dbg_printf("AMOMAX.W r%d, r%d, r%d\n", rd, rs1, rs2);
-  RB[rd] = DM.read(RB[rs1]);
-  dbg_printf("RB[rd] = %d\n", RB[rd]);
-  dbg_printf("RB[rs2] = %d\n\n", RB[rs2]);
-  if (RB[rd] > RB[rs2])
-    DM.write(RB[rs1], RB[rd]);
-  else
-    DM.write(RB[rs1], RB[rs2]);
+  amo(RISCV_AMO_MAX, false, rd, RB[rs1], RB[rs2]);
+  dbg_printf("Result = %#x\n\n", RB[rd]);
 }
 
 // Instruction AMOMINU.W behavior method
 void ac_behavior(AMOMINU_W) {
   dbg_printf("AMOMINU.W r%d, r%d, r%d\n", rd, rs1, rs2);
-  RB[rd] = DM.read(RB[rs1]);
-  dbg_printf("RB[rd] = %d\n", RB[rd]);
-  dbg_printf("RB[rs2] = %d\n\n", RB[rs2]);
-  if ((ac_Uword)RB[rd] < (ac_Uword)RB[rs2])
-    DM.write(RB[rs1], RB[rd]);
-  else
-    DM.write(RB[rs1], RB[rs2]);
+  amo(RISCV_AMO_MINU, false, rd, RB[rs1], RB[rs2]);
+  dbg_printf("Result = %#x\n\n", RB[rd]);
 }
 
 // Instruction AMOMAXU.W behavior method
 void ac_behavior(AMOMAXU_W) {
   dbg_printf("AMOMAXU.W r%d, r%d, r%d\n", rd, rs1, rs2);
-  RB[rd] = DM.read(RB[rs1]);
-  dbg_printf("RB[rd] = %d\n", RB[rd]);
-  dbg_printf("RB[rs2] = %d\n", RB[rs2]);
-  if ((ac_Uword)RB[rd] > (ac_Uword)RB[rs2])
-    DM.write(RB[rs1], RB[rd]);
-  else
-    DM.write(RB[rs1], RB[rs2]);
+  amo(RISCV_AMO_MAXU, false, rd, RB[rs1], RB[rs2]);
+  dbg_printf("Result = %#x\n\n", RB[rd]);
 }
 
 // Instruction FLW behavior method
 void ac_behavior(FLW) {
+  FP_PROFILE(0, 4);
   int offset;
   offset = (imm4 << 11) | (imm3 << 5) | (imm2 << 1) | imm1;
   dbg_printf("FLW r%d, r%d, %d\n", rd, rs1, offset);
   int sign_ext;
   sign_ext = sign_extend(offset, 12);
-  RBF[rd] = DM.read(RB[rs1] + sign_ext);
+  LOAD_ALIGN(RB[rs1] + sign_ext, 4);
+  MEM_READ_HOOK(RB[rs1] + sign_ext, 4);
+  save_float_bits(READ_WORD(RB[rs1] + sign_ext), rd);
   dbg_printf("RB[rs1] = %#x\n", RB[rs1]);
   dbg_printf("addr = %#x\n", RB[rs1] + sign_ext);
-  dbg_printf("Result = %.3f\n\n", (float)RBF[rd]);
+  dbg_printf("Result = %.3f\n\n", load_float(rd));
 }
 
 // Instruction FSW behavior method
 void ac_behavior(FSW) {
+  FP_PROFILE(0, 4);
   int imm;
   imm = (imm4 << 11) | (imm3 << 5) | (imm2 << 1) | imm1;
   dbg_printf("FSW r%d, r%d, %d\n", rs1, rs2, imm);
   int sign_ext;
   sign_ext = sign_extend(imm, 12);
-  DM.write(RB[rs1] + sign_ext, RBF[rs2]);
+  STORE_ALIGN(RB[rs1] + sign_ext, 4);
+  MEM_WRITE_HOOK(RB[rs1] + sign_ext, 4);
+  WRITE_WORD(RB[rs1] + sign_ext, (uint32_t)RBF[rs2]);
   dbg_printf("addr: %d\n\n", RB[rs1] + sign_ext);
 }
 
 // Instruction FADD.S behavior method
 void ac_behavior(FADD_S) {
+  FP_PROFILE(1, 0);
   dbg_printf("FADD.S r%d, r%d, r%d\n", rd, rs1, rs2);
+  SOFT_FP_RM(S, funct3,
+             sf::add<sf::f32>(FS(rs1), FS(rs2), FP_MODE(funct3), soft_flags));
+  FP_ROUND(funct3);
   dbg_printf("RBF[rs1] = %.3f\n", load_float(rs1));
   dbg_printf("RBF[rs2] = %.3f\n", load_float(rs2));
   float sum;
   sum = load_float(rs1) + load_float(rs2);
   save_float(sum, rd);
   dbg_printf("Result = %.3f\n\n", sum);
+  SOFT_CHECK(S, "FADD.S");
 }
 
 // Instruction FSUB.S behavior method
 void ac_behavior(FSUB_S) {
+  FP_PROFILE(1, 0);
   dbg_printf("FSUB.S r%d, r%d, r%d\n", rd, rs1, rs2);
+  SOFT_FP_RM(S, funct3,
+             sf::sub<sf::f32>(FS(rs1), FS(rs2), FP_MODE(funct3), soft_flags));
+  FP_ROUND(funct3);
   dbg_printf("RBF[rs1] = %.3f\n", load_float(rs1));
   dbg_printf("RBF[rs2] = %.3f\n", load_float(rs2));
   float diff;
   diff = load_float(rs1) - load_float(rs2);
   save_float(diff, rd);
   dbg_printf("Result = %.3f\n\n", diff);
+  SOFT_CHECK(S, "FSUB.S");
 }
 
 // Instruction FMUL.S behavior method
 void ac_behavior(FMUL_S) {
+  FP_PROFILE(1, 0);
   dbg_printf("FMUL.S r%d, r%d, r%d\n", rd, rs1, rs2);
+  SOFT_FP_RM(S, funct3,
+             sf::mul<sf::f32>(FS(rs1), FS(rs2), FP_MODE(funct3), soft_flags));
+  FP_ROUND(funct3);
   dbg_printf("RBF[rs1] = %.3f\n", load_float(rs1));
   dbg_printf("RBF[rs2] = %.3f\n", load_float(rs2));
   float product;
   product = load_float(rs1) * load_float(rs2);
   save_float(product, rd);
   dbg_printf("Result = %.3f\n\n", product);
+  SOFT_CHECK(S, "FMUL.S");
 }
 
 // Instruction FDIV.S behavior method
 void ac_behavior(FDIV_S) {
+  FP_PROFILE(1, 0);
   dbg_printf("FDIV.S r%d, r%d, r%d\n", rd, rs1, rs2);
+  SOFT_FP_RM(S, funct3,
+             sf::div<sf::f32>(FS(rs1), FS(rs2), FP_MODE(funct3), soft_flags));
+  FP_ROUND(funct3);
   dbg_printf("RBF[rs1] = %.3f\n", load_float(rs1));
   dbg_printf("RBF[rs2] = %.3f\n", load_float(rs2));
   float quot;
   quot = load_float(rs1) / load_float(rs2);
   save_float(quot, rd);
   dbg_printf("Result = %.3f\n\n", quot);
+  SOFT_CHECK(S, "FDIV.S");
 }
 
 // Instruction FMIN.S behavior method
 void ac_behavior(FMIN_S) {
   dbg_printf("FMIN.S r%d, r%d, r%d\n", rd, rs1, rs2);
+  SOFT_FP(S, sf::minmax<sf::f32>(FS(rs1), FS(rs2), false, soft_flags));
   dbg_printf("RBF[rs1] = %.3f\n", load_float(rs1));
   dbg_printf("RBF[rs2] = %.3f\n", load_float(rs2));
+  if (float_is_snan(load_float(rs1)) || float_is_snan(load_float(rs2)))
+    fp_pending |= FFLAG_NV;
   float temp;
-  if (load_float(rs1) < load_float(rs2)) {
-    temp = load_float(rs1);
-    save_float(temp, rd);
-  } else {
-    temp = load_float(rs2);
-    save_float(temp, rd);
-  }
+  temp = fp_minmax(load_float(rs1), load_float(rs2), false);
+  save_float(temp, rd);
   dbg_printf("Result = %.3f\n\n", temp);
+  SOFT_CHECK(S, "FMIN.S");
 }
 
 // Instruction FMAX.S behavior method
 void ac_behavior(FMAX_S) {
   dbg_printf("FMAX.S r%d, r%d, r%d\n", rd, rs1, rs2);
+  SOFT_FP(S, sf::minmax<sf::f32>(FS(rs1), FS(rs2), true, soft_flags));
   dbg_printf("RBF[rs1] = %.3f\n", load_float(rs1));
   dbg_printf("RBF[rs2] = %.3f\n", load_float(rs2));
+  if (float_is_snan(load_float(rs1)) || float_is_snan(load_float(rs2)))
+    fp_pending |= FFLAG_NV;
   float temp;
-  if (load_float(rs1) > load_float(rs2)) {
-    temp = load_float(rs1);
-    save_float(temp, rd);
-  } else {
-    temp = load_float(rs2);
-    save_float(temp, rd);
-  }
+  temp = fp_minmax(load_float(rs1), load_float(rs2), true);
+  save_float(temp, rd);
   dbg_printf("Result = %.3f\n\n", temp);
+  SOFT_CHECK(S, "FMAX.S");
 }
 
 // Instruction FSQRT.S behavior method
 void ac_behavior(FSQRT_S) {
+  FP_PROFILE(1, 0);
   dbg_printf("FSQRT.S r%d, r%d\n", rd, rs1);
+  SOFT_FP_RM(S, funct3,
+             sf::sqrt<sf::f32>(FS(rs1), FP_MODE(funct3), soft_flags));
+  FP_ROUND(funct3);
   dbg_printf("RBF[rs1] = %.3f\n", load_float(rs1));
   float temp;
-  if (load_float(rs1) < 0) {
-    dbg_printf("Invalid!");
-    stop();
-  } else
-    RBF[rd] = sqrt(RBF[rs1]);
-  dbg_printf("Result = %.3f\n\n", (float)RBF[rd]);
+  temp = sqrtf(load_float(rs1));
+  save_float(temp, rd);
+  dbg_printf("Result = %.3f\n\n", temp);
+  SOFT_CHECK(S, "FSQRT.S");
 }
 
 // Instruction FMADD.S behavior method
 void ac_behavior(FMADD_S) {
+  FP_PROFILE(2, 0);
   dbg_printf("FMADD.S r%d, r%d, r%d, r%d\n", rd, rs1, rs2, rs3);
+  SOFT_FP_RM(S, funct3,
+             sf::fma<sf::f32>(FS(rs1), FS(rs2), FS(rs3), FP_MODE(funct3),
+                              soft_flags));
+  FP_ROUND(funct3);
   dbg_printf("RBF[rs1] = %.3f\n", load_float(rs1));
   dbg_printf("RBF[rs2] = %.3f\n", load_float(rs2));
   dbg_printf("RBF[rs2] = %.3f\n", load_float(rs3));
   float res;
-  res = load_float(rs1) * load_float(rs2) + load_float(rs3);
+  res = fused_s(load_float(rs1), load_float(rs2), load_float(rs3));
   save_float(res, rd);
   dbg_printf("Result = %.3f\n\n", res);
+  SOFT_CHECK(S, "FMADD.S");
 }
 
 // Instruction FMSUB.S behavior method
 void ac_behavior(FMSUB_S) {
+  FP_PROFILE(2, 0);
   dbg_printf("FMSUB.S r%d, r%d, r%d, r%d\n", rd, rs1, rs2, rs3);
+  SOFT_FP_RM(S, funct3,
+             sf::fma<sf::f32>(FS(rs1), FS(rs2), FS(rs3) ^ sf::f32::SIGN,
+                              FP_MODE(funct3), soft_flags));
+  FP_ROUND(funct3);
   dbg_printf("RBF[rs1] = %.3f\n", load_float(rs1));
   dbg_printf("RBF[rs2] = %.3f\n", load_float(rs2));
   dbg_printf("RBF[rs2] = %.3f\n", load_float(rs3));
   float res;
-  res = load_float(rs1) * load_float(rs2) - load_float(rs3);
+  res = fused_s(load_float(rs1), load_float(rs2), -load_float(rs3));
   save_float(res, rd);
   dbg_printf("Result = %.3f\n\n", res);
+  SOFT_CHECK(S, "FMSUB.S");
 }
 
 // Instruction FNMSUB.S behavior method
 void ac_behavior(FNMSUB_S) {
+  FP_PROFILE(2, 0);
   dbg_printf("FNMSUB.S r%d, r%d, r%d, r%d\n", rd, rs1, rs2, rs3);
+  SOFT_FP_RM(S, funct3,
+             sf::fma<sf::f32>(FS(rs1) ^ sf::f32::SIGN, FS(rs2), FS(rs3),
+                              FP_MODE(funct3), soft_flags));
+  FP_ROUND(funct3);
   dbg_printf("RBF[rs1] = %.3f\n", load_float(rs1));
   dbg_printf("RBF[rs2] = %.3f\n", load_float(rs2));
   dbg_printf("RBF[rs2] = %.3f\n", load_float(rs3));
   float res;
-  res = (-(load_float(rs1) * load_float(rs2) - load_float(rs3)));
+  res = fused_s(-load_float(rs1), load_float(rs2), load_float(rs3));
   save_float(res, rd);
   dbg_printf("Result = %.3f\n\n", res);
+  SOFT_CHECK(S, "FNMSUB.S");
 }
 
 // Instruction FNMADD.S behavior method
 void ac_behavior(FNMADD_S) {
+  FP_PROFILE(2, 0);
   dbg_printf("FNMADD.S r%d, r%d, r%d, r%d\n", rd, rs1, rs2, rs3);
+  SOFT_FP_RM(S, funct3,
+             sf::fma<sf::f32>(FS(rs1) ^ sf::f32::SIGN, FS(rs2),
+                              FS(rs3) ^ sf::f32::SIGN, FP_MODE(funct3),
+                              soft_flags));
+  FP_ROUND(funct3);
   dbg_printf("RBF[rs1] = %.3f\n", load_float(rs1));
   dbg_printf("RBF[rs2] = %.3f\n", load_float(rs2));
   dbg_printf("RBF[rs2] = %.3f\n", load_float(rs3));
   float res;
-  res = (-(load_float(rs1) * load_float(rs2) + load_float(rs3)));
+  res = fused_s(-load_float(rs1), load_float(rs2), -load_float(rs3));
   save_float(res, rd);
   dbg_printf("Result = %.3f\n\n", res);
+  SOFT_CHECK(S, "FNMADD.S");
 }
 
 // Instruction FCVT.W.S behavior method
 void ac_behavior(FCVT_W_S) {
   dbg_printf("FCVT.W.S r%d, r%d\n", rd, rs1);
+  FP_RM_LEGAL(funct3);
+  SOFT_FP(X, sf::to_int<sf::f32>(FS(rs1), FP_MODE(funct3), true, soft_flags));
   dbg_printf("RBF[rs1] = %f\n", load_float(rs1));
-  RB[rd] = round(load_float(rs1));
+  RB[rd] = (int32_t)fcvt_int(load_float(rs1), FP_MODE(funct3), true, fp_pending);
   dbg_printf("RB[rd] = %d \n \n", RB[rd]);
+  SOFT_CHECK(X, "FCVT.W.S");
 }
 
 // Instruction FCVT.WU.S behavior method
 void ac_behavior(FCVT_WU_S) {
   dbg_printf("FCVT.WU.S r%d, r%d\n", rd, rs1);
+  FP_RM_LEGAL(funct3);
+  SOFT_FP(X, sf::to_int<sf::f32>(FS(rs1), FP_MODE(funct3), false, soft_flags));
   dbg_printf("RBF[rs1] = %f\n", load_float(rs1));
-  RB[rd] = (unsigned int)(load_float(rs1));
+  RB[rd] = (int32_t)fcvt_int(load_float(rs1), FP_MODE(funct3), false, fp_pending);
   dbg_printf("RB[rd] = %d \n \n", RB[rd]);
+  SOFT_CHECK(X, "FCVT.WU.S");
 }
 
 // Instruction FCVT.S.W behaior method
 void ac_behavior(FCVT_S_W) {
   dbg_printf("FCVT.S.W r%d, r%d \n", rd, rs1);
+  SOFT_FP_RM(S, funct3,
+             sf::from_int<sf::f32>((int32_t)RB[rs1], FP_MODE(funct3),
+                                   soft_flags));
+  FP_ROUND(funct3);
   dbg_printf("RB[rs1] = %d \n", RB[rs1]);
   float temp;
-  ac_Sword b = RB[rs1];
+  int32_t b = RB[rs1];
   temp = (float)b;
   save_float(temp, rd);
+  SOFT_CHECK(S, "FCVT.S.W");
 }
 
 // Instruction FCVT_S_WU behaior method
 void ac_behavior(FCVT_S_WU) {
   dbg_printf("FCVT.S.W r%d, r%d \n", rd, rs1);
+  SOFT_FP_RM(S, funct3,
+             sf::from_int<sf::f32>((uint32_t)RB[rs1], FP_MODE(funct3),
+                                   soft_flags));
+  FP_ROUND(funct3);
   dbg_printf("RB[rs1] = %d \n", RB[rs1]);
   float temp;
-  ac_Uword b = RB[rs1];
+  uint32_t b = RB[rs1];
   temp = (float)b;
   save_float(temp, rd);
+  SOFT_CHECK(S, "FCVT.S.WU");
 }
 
 // Instruction FSGNJ_S behavior method
@@ -1096,20 +2931,20 @@ void ac_behavior(FSGNJX_D) {
 }
 
 
-// Instruction FMV_X_S behavior method
-void ac_behavior(FMV_X_S) {
-  dbg_printf("FMV.X.S r%d, r%d \n", rd, rs1);
+// Instruction FMV_X_W behavior method
+void ac_behavior(FMV_X_W) {
+  dbg_printf("FMV.X.W r%d, r%d \n", rd, rs1);
   dbg_printf("RBF[rs1] = %f \n", load_float(rs1));
-  memcpy(&RB[rd], &RBF[rs1], sizeof(uint32_t));
+  RB[rd] = (int32_t)RBF[rs1];
   // RB[rd] = (int)load_float(rs1);
   dbg_printf("RB[rd] = %d \n \n", RB[rd]);
 }
 
-// Instruction FMV_S_X behavior method
-void ac_behavior(FMV_S_X) {
-  dbg_printf("FMV.S.X r%d, r%d \n", rd, rs1);
+// Instruction FMV_W_X behavior method
+void ac_behavior(FMV_W_X) {
+  dbg_printf("FMV.W.X r%d, r%d \n", rd, rs1);
   dbg_printf("RB[rs1] = %d \n", RB[rs1]);
-  memcpy(&RBF[rd], &RB[rs1], sizeof(uint32_t));
+  save_float_bits(RB[rs1], rd);
   // save_float(RB[rs1], rd);
   dbg_printf("RBF[rd] = %f \n \n", load_float(rd));
 }
@@ -1117,49 +2952,61 @@ void ac_behavior(FMV_S_X) {
 // Instruction FEQ_S behavior method
 void ac_behavior(FEQ_S) {
   dbg_printf("FEQ.S r%d, r%d, r%d \n", rd, rs1, rs2);
+  SOFT_FP(X, sf::eq<sf::f32>(FS(rs1), FS(rs2), soft_flags));
+  FP_FLAGS();
   dbg_printf("RBF[rs1] = %f \n", load_float(rs1));
   dbg_printf("RBF[rs2] = %f \n", load_float(rs2));
-  if ((custom_isnan(load_float(rs1)) == 1) || (custom_isnan(load_float(rs2)) == 1)) {
-    printf("Invalid Operation\n");
-    RB[rd] = 0;
-  }
+  if (float_is_snan(load_float(rs1)) || float_is_snan(load_float(rs2)))
+    fp_pending |= FFLAG_NV;
   if (load_float(rs1) == load_float(rs2))
     RB[rd] = 1;
   else
     RB[rd] = 0;
   dbg_printf("Result = %d \n \n", RB[rd]);
+  SOFT_CHECK(X, "FEQ.S");
 }
 
 // Instruction FLE_S behavior method
 void ac_behavior(FLE_S) {
   dbg_printf("FLE.S r%d, r%d, r%d \n", rd, rs1, rs2);
+  SOFT_FP(X, sf::le<sf::f32>(FS(rs1), FS(rs2), soft_flags));
+  FP_FLAGS();
   dbg_printf("RBF[rs1] = %f \n", load_float(rs1));
   dbg_printf("RBF[rs2] = %f \n", load_float(rs2));
   if ((custom_isnan(load_float(rs1)) == 1) || (custom_isnan(load_float(rs2)) == 1)) {
-    printf("Invalid Operation\n");
-    RB[rd] = 0;
+    fp_pending |= FFLAG_NV;
   }
   if (load_float(rs1) <= load_float(rs2))
     RB[rd] = 1;
   else
     RB[rd] = 0;
   dbg_printf("Result = %d \n \n", RB[rd]);
+  SOFT_CHECK(X, "FLE.S");
+}
+
+// Instruction FCLASS_S behavior method
+void ac_behavior(FCLASS_S) {
+  dbg_printf("FCLASS.S r%d, r%d \n", rd, rs1);
+  RB[rd] = fclass(load_float_bits(rs1), 8, 23);
+  dbg_printf("Result = %#x \n \n", RB[rd]);
 }
 
 // Instruction FLT_S behavior method
 void ac_behavior(FLT_S) {
   dbg_printf("FLT.S r%d, r%d, r%d \n", rd, rs1, rs2);
+  SOFT_FP(X, sf::lt<sf::f32>(FS(rs1), FS(rs2), soft_flags));
+  FP_FLAGS();
   dbg_printf("RBF[rs1] = %f \n", load_float(rs1));
   dbg_printf("RBF[rs2] = %f \n", load_float(rs2));
   if ((custom_isnan(load_float(rs1)) == 1) || (custom_isnan(load_float(rs2)) == 1)) {
-    printf("Invalid Operation\n");
-    RB[rd] = 0;
+    fp_pending |= FFLAG_NV;
   }
   if (load_float(rs1) < load_float(rs2))
     RB[rd] = 1;
   else
     RB[rd] = 0;
   dbg_printf("Result = %d \n \n", RB[rd]);
+  SOFT_CHECK(X, "FLT.S");
 }
 
 // Instruction FMV.S behavior method
@@ -1172,13 +3019,15 @@ void ac_behavior(FMV_S) {
 
 // Instruction FLD behavior method
 void ac_behavior(FLD) {
+  FP_PROFILE(0, 8);
   int imm;
   imm = (imm4 << 11) | (imm3 << 5) | (imm2 << 1) | imm1;
   dbg_printf("FLD r%d, r%d, %d\n", rd, rs1, imm);
   int sign_ext;
   sign_ext = sign_extend(imm, 12);
-  RBF[rd * 2] = DM.read(RB[rs1] + sign_ext);
-  RBF[rd * 2 + 1] = DM.read(RB[rs1] + sign_ext + 4);
+  LOAD_ALIGN(RB[rs1] + sign_ext, 8);
+  MEM_READ_HOOK(RB[rs1] + sign_ext, 8);
+  RBF[rd] = READ_DWORD(RB[rs1] + sign_ext);
   dbg_printf("RB[rs1] = %#x\n", RB[rs1]);
   dbg_printf("addr = %#x\n", RB[rs1] + sign_ext);
   double temp = load_double(rd);
@@ -1187,207 +3036,279 @@ void ac_behavior(FLD) {
 
 // Instruction FSD behavior method
 void ac_behavior(FSD) {
+  FP_PROFILE(0, 8);
   int imm;
   imm = (imm4 << 11) | (imm3 << 5) | (imm2 << 1) | imm1;
   dbg_printf("FSD r%d, r%d, %d\n", rs1, rs2, imm);
   int sign_ext;
   sign_ext = sign_extend(imm, 12);
-  DM.write(RB[rs1] + sign_ext, RBF[rs2 * 2]);
-  DM.write(RB[rs1] + sign_ext + 4, RBF[rs2 * 2 + 1]);
+  STORE_ALIGN(RB[rs1] + sign_ext, 8);
+  MEM_WRITE_HOOK(RB[rs1] + sign_ext, 8);
+  WRITE_DWORD(RB[rs1] + sign_ext, RBF[rs2]);
   dbg_printf("addr: %d\n\n", RB[rs1] + sign_ext);
 }
 
 // Instruction FADD.D behavior method
 void ac_behavior(FADD_D) {
+  FP_PROFILE(1, 0);
   dbg_printf("FADD.D r%d, r%d, r%d\n", rd, rs1, rs2);
+  SOFT_FP_RM(D, funct3,
+             sf::add<sf::f64>(FD(rs1), FD(rs2), FP_MODE(funct3), soft_flags));
+  FP_ROUND(funct3);
   dbg_printf("RBF[rs1] = %.3f\n", load_double(rs1));
   dbg_printf("RBF[rs2] = %.3f\n", load_double(rs2));
   double sum;
   sum = load_double(rs1) + load_double(rs2);
   save_double(sum, rd);
   dbg_printf("Result = %.3f\n\n", sum);
+  SOFT_CHECK(D, "FADD.D");
 }
 
 // Instruction FSUB.D behavior method
 void ac_behavior(FSUB_D) {
+  FP_PROFILE(1, 0);
   dbg_printf("FSUB.D r%d, r%d, r%d\n", rd, rs1, rs2);
+  SOFT_FP_RM(D, funct3,
+             sf::sub<sf::f64>(FD(rs1), FD(rs2), FP_MODE(funct3), soft_flags));
+  FP_ROUND(funct3);
   dbg_printf("RBF[rs1] = %.3f\n", load_double(rs1));
   dbg_printf("RBF[rs2] = %.3f\n", load_double(rs2));
   double diff;
   diff = load_double(rs1) - load_double(rs2);
   save_double(diff, rd);
   dbg_printf("Result = %.3f\n\n", diff);
+  SOFT_CHECK(D, "FSUB.D");
 }
 
 // Instruction FMUL.D behavior method
 void ac_behavior(FMUL_D) {
+  FP_PROFILE(1, 0);
   dbg_printf("FMUL.D r%d, r%d, r%d\n", rd, rs1, rs2);
+  SOFT_FP_RM(D, funct3,
+             sf::mul<sf::f64>(FD(rs1), FD(rs2), FP_MODE(funct3), soft_flags));
+  FP_ROUND(funct3);
   dbg_printf("RBF[rs1] = %.3f\n", load_double(rs1));
   dbg_printf("RBF[rs2] = %.3f\n", load_double(rs2));
   double product;
   product = load_double(rs1) * load_double(rs2);
   save_double(product, rd);
   dbg_printf("Result = %.3f\n\n", product);
+  SOFT_CHECK(D, "FMUL.D");
 }
 
 // Instruction FDIV.D behavior method
 void ac_behavior(FDIV_D) {
+  FP_PROFILE(1, 0);
   dbg_printf("FDIV.D r%d, r%d, r%d\n", rd, rs1, rs2);
+  SOFT_FP_RM(D, funct3,
+             sf::div<sf::f64>(FD(rs1), FD(rs2), FP_MODE(funct3), soft_flags));
+  FP_ROUND(funct3);
   dbg_printf("RBF[rs1] = %.3f\n", load_double(rs1));
   dbg_printf("RBF[rs2] = %.3f\n", load_double(rs2));
   double quot;
   quot = load_double(rs1) / load_double(rs2);
   save_double(quot, rd);
   dbg_printf("Result = %.3f\n\n", quot);
+  SOFT_CHECK(D, "FDIV.D");
 }
 
 // Instruction FMIN.D behavior method
 void ac_behavior(FMIN_D) {
   dbg_printf("FMIN.S r%d, r%d, r%d\n", rd, rs1, rs2);
+  SOFT_FP(D, sf::minmax<sf::f64>(FD(rs1), FD(rs2), false, soft_flags));
   dbg_printf("RBF[rs1] = %.3f\n", load_double(rs1));
   dbg_printf("RBF[rs2] = %.3f\n", load_double(rs2));
+  if (double_is_snan(load_double(rs1)) || double_is_snan(load_double(rs2)))
+    fp_pending |= FFLAG_NV;
   double temp;
-  if (load_double(rs1) < load_double(rs2)) {
-    temp = load_double(rs1);
-    save_double(temp, rd);
-  } else {
-    temp = load_double(rs2);
-    save_double(temp, rd);
-  }
+  temp = fp_minmax(load_double(rs1), load_double(rs2), false);
+  save_double(temp, rd);
   dbg_printf("Result = %.3f\n\n", temp);
+  SOFT_CHECK(D, "FMIN.D");
 }
 
 // Instruction FMAX.D behavior method
 void ac_behavior(FMAX_D) {
   dbg_printf("FMAX.D r%d, r%d, r%d\n", rd, rs1, rs2);
+  SOFT_FP(D, sf::minmax<sf::f64>(FD(rs1), FD(rs2), true, soft_flags));
   dbg_printf("RBF[rs1] = %.3f\n", load_double(rs1));
   dbg_printf("RBF[rs2] = %.3f\n", load_double(rs2));
+  if (double_is_snan(load_double(rs1)) || double_is_snan(load_double(rs2)))
+    fp_pending |= FFLAG_NV;
   double temp;
-  if (load_double(rs1) > load_double(rs2)) {
-    temp = load_double(rs1);
-    save_double(temp, rd);
-  } else {
-    temp = load_double(rs2);
-    save_double(temp, rd);
-  }
+  temp = fp_minmax(load_double(rs1), load_double(rs2), true);
+  save_double(temp, rd);
   dbg_printf("Result = %.3f\n\n", temp);
+  SOFT_CHECK(D, "FMAX.D");
 }
 
 // Instruction FSQRT.D behavior method
 void ac_behavior(FSQRT_D) {
+  FP_PROFILE(1, 0);
   dbg_printf("FSQRT.D r%d, r%d\n", rd, rs1);
+  SOFT_FP_RM(D, funct3,
+             sf::sqrt<sf::f64>(FD(rs1), FP_MODE(funct3), soft_flags));
+  FP_ROUND(funct3);
   dbg_printf("RBF[rs1] = %.3f\n", load_double(rs1));
   double temp;
-  if (load_double(rs1) < 0) {
-    dbg_printf("Invalid!");
-    stop();
-  } else {
-    temp = sqrt(load_double(rs1));
-    save_double(temp, rd);
-  }
+  temp = sqrt(load_double(rs1));
+  save_double(temp, rd);
   dbg_printf("Result = %.3f\n\n", temp);
+  SOFT_CHECK(D, "FSQRT.D");
 }
 
 // Instruction FMADD.D behavior method
 void ac_behavior(FMADD_D) {
+  FP_PROFILE(2, 0);
   dbg_printf("FMADD.D r%d, r%d, r%d, r%d\n", rd, rs1, rs2, rs3);
+  SOFT_FP_RM(D, funct3,
+             sf::fma<sf::f64>(FD(rs1), FD(rs2), FD(rs3), FP_MODE(funct3),
+                              soft_flags));
+  FP_ROUND(funct3);
   dbg_printf("RBF[rs1] = %.3f\n", load_double(rs1));
   dbg_printf("RBF[rs2] = %.3f\n", load_double(rs2));
   dbg_printf("RBF[rs2] = %.3f\n", load_double(rs3));
   double res;
-  res = load_double(rs1) * load_double(rs2) + load_double(rs3);
+  res = fused_d(load_double(rs1), load_double(rs2), load_double(rs3));
   save_double(res, rd);
   dbg_printf("Result = %.3f\n\n", res);
+  SOFT_CHECK(D, "FMADD.D");
 }
 
 // Instruction FMSUB.D behavior method
 void ac_behavior(FMSUB_D) {
+  FP_PROFILE(2, 0);
   dbg_printf("FMSUB.D r%d, r%d, r%d, r%d\n", rd, rs1, rs2, rs3);
+  SOFT_FP_RM(D, funct3,
+             sf::fma<sf::f64>(FD(rs1), FD(rs2), FD(rs3) ^ sf::f64::SIGN,
+                              FP_MODE(funct3), soft_flags));
+  FP_ROUND(funct3);
   dbg_printf("RBF[rs1] = %.3f\n", load_double(rs1));
   dbg_printf("RBF[rs2] = %.3f\n", load_double(rs2));
   dbg_printf("RBF[rs2] = %.3f\n", load_double(rs3));
   double res;
-  res = load_double(rs1) * load_double(rs2) - load_double(rs3);
+  res = fused_d(load_double(rs1), load_double(rs2), -load_double(rs3));
   save_double(res, rd);
   dbg_printf("Result = %.3f\n\n", res);
+  SOFT_CHECK(D, "FMSUB.D");
 }
 
 // Instruction FNMSUB.D behavior method
 void ac_behavior(FNMSUB_D) {
+  FP_PROFILE(2, 0);
   dbg_printf("FNMSUB.D r%d, r%d, r%d, r%d\n", rd, rs1, rs2, rs3);
+  SOFT_FP_RM(D, funct3,
+             sf::fma<sf::f64>(FD(rs1) ^ sf::f64::SIGN, FD(rs2), FD(rs3),
+                              FP_MODE(funct3), soft_flags));
+  FP_ROUND(funct3);
   dbg_printf("RBF[rs1] = %.3f\n", load_double(rs1));
   dbg_printf("RBF[rs2] = %.3f\n", load_double(rs2));
   dbg_printf("RBF[rs2] = %.3f\n", load_double(rs3));
   double res;
-  res = (-(load_double(rs1) * load_double(rs2) - load_double(rs3)));
+  res = fused_d(-load_double(rs1), load_double(rs2), load_double(rs3));
   save_double(res, rd);
   dbg_printf("Result = %.3f\n\n", res);
+  SOFT_CHECK(D, "FNMSUB.D");
 }
 
 // Instruction FNMADD.D behavior method
 void ac_behavior(FNMADD_D) {
+  FP_PROFILE(2, 0);
   dbg_printf("FNMADD.D r%d, r%d, r%d, r%d\n", rd, rs1, rs2, rs3);
+  SOFT_FP_RM(D, funct3,
+             sf::fma<sf::f64>(FD(rs1) ^ sf::f64::SIGN, FD(rs2),
+                              FD(rs3) ^ sf::f64::SIGN, FP_MODE(funct3),
+                              soft_flags));
+  FP_ROUND(funct3);
   dbg_printf("RBF[rs1] = %.3f\n", load_double(rs1));
   dbg_printf("RBF[rs2] = %.3f\n", load_double(rs2));
   dbg_printf("RBF[rs2] = %.3f\n", load_double(rs3));
   double res;
-  res = (-(load_double(rs1) * load_double(rs2) + load_double(rs3)));
+  res = fused_d(-load_double(rs1), load_double(rs2), -load_double(rs3));
   save_double(res, rd);
   dbg_printf("Result = %.3f\n\n", res);
+  SOFT_CHECK(D, "FNMADD.D");
 }
 
 // Instruction FCVT.W.D behavior method
 void ac_behavior(FCVT_W_D) {
   dbg_printf("FCVT.W.D r%d, r%d\n", rd, rs1);
+  FP_RM_LEGAL(funct3);
+  SOFT_FP(X, sf::to_int<sf::f64>(FD(rs1), FP_MODE(funct3), true, soft_flags));
   dbg_printf("RBF[rs1] = %f\n", load_double(rs1));
-  RB[rd] = lround(load_double(rs1));
+  RB[rd] = (int32_t)fcvt_int(load_double(rs1), FP_MODE(funct3), true, fp_pending);
   dbg_printf("RB[rd] = %d \n \n", RB[rd]);
+  SOFT_CHECK(X, "FCVT.W.D");
 }
 
 // Instruction FCVT.WU.D behavior method
 void ac_behavior(FCVT_WU_D) {
   dbg_printf("FCVT.WU.D r%d, r%d\n", rd, rs1);
+  FP_RM_LEGAL(funct3);
+  SOFT_FP(X, sf::to_int<sf::f64>(FD(rs1), FP_MODE(funct3), false, soft_flags));
   dbg_printf("RBF[rs1] = %f\n", load_double(rs1));
-  RB[rd] = (unsigned int)(load_double(rs1));
+  RB[rd] = (int32_t)fcvt_int(load_double(rs1), FP_MODE(funct3), false, fp_pending);
   dbg_printf("RB[rd] = %d \n \n", RB[rd]);
+  SOFT_CHECK(X, "FCVT.WU.D");
 }
 
 // Instruction FCVT_D_W behaior method
 void ac_behavior(FCVT_D_W) {
   dbg_printf("FCVT.D.W r%d, r%d \n", rd, rs1);
+  SOFT_FP_RM(D, funct3,
+             sf::from_int<sf::f64>((int32_t)RB[rs1], FP_MODE(funct3),
+                                   soft_flags));
   dbg_printf("RB[rs1] = %d \n", RB[rs1]);
   double temp;
-  ac_Sword b = RB[rs1];
+  int32_t b = RB[rs1];
   temp = (double)b;
   save_double(temp, rd);
+  SOFT_CHECK(D, "FCVT.D.W");
 }
 
 // Instruction FCVT_D_WU behaior method
 void ac_behavior(FCVT_D_WU) {
   dbg_printf("FCVT.D.W r%d, r%d \n", rd, rs1);
+  SOFT_FP_RM(D, funct3,
+             sf::from_int<sf::f64>((uint32_t)RB[rs1], FP_MODE(funct3),
+                                   soft_flags));
   dbg_printf("RB[rs1] = %d \n", RB[rs1]);
   double temp;
-  ac_Uword b = RB[rs1];
+  uint32_t b = RB[rs1];
   temp = (double)b;
   save_double(temp, rd);
+  SOFT_CHECK(D, "FCVT.D.WU");
 }
 
 // Instruction FCVT_S_D behavior method
 void ac_behavior(FCVT_S_D) {
   dbg_printf("FCVT.S.D r%d, r%d", rd, rs1);
+  SOFT_FP_RM(S, funct3,
+             (sf::convert<sf::f64, sf::f32>(FD(rs1), FP_MODE(funct3),
+                                            soft_flags)));
+  FP_ROUND(funct3);
   dbg_printf("RBF[rs1] = %f \n", load_float(rs1));
   float temp;
   temp = (float)(load_double(rs1));
   save_float(temp, rd);
+  SOFT_CHECK(S, "FCVT.S.D");
 }
 
 // Instruction FCVT_D_S behavior method
 void ac_behavior(FCVT_D_S) {
   dbg_printf("FCVT.D.S r%d, r%d", rd, rs1);
+  SOFT_FP_RM(D, funct3,
+             (sf::convert<sf::f32, sf::f64>(FS(rs1), FP_MODE(funct3),
+                                            soft_flags)));
+  FP_FLAGS();
   dbg_printf("RBF[rs1] = %f \n", load_double(rs1));
+  // Exact, so no rounding mode; a signaling NaN input still raises NV
+  if (float_is_snan(load_float(rs1)))
+    fp_pending |= FFLAG_NV;
   double temp;
   temp = (double)(load_float(rs1));
   save_double(temp, rd);
+  SOFT_CHECK(D, "FCVT.D.S");
 }
 
 // Instruction FMV.D behavior method
@@ -1401,50 +3322,832 @@ void ac_behavior(FMV_D) {
 // Instruction FEQ_D behavior method
 void ac_behavior(FEQ_D) {
   dbg_printf("FEQ.D r%d, r%d, r%d \n", rd, rs1, rs2);
+  SOFT_FP(X, sf::eq<sf::f64>(FD(rs1), FD(rs2), soft_flags));
+  FP_FLAGS();
   dbg_printf("RBF[rs1] = %f \n", load_double(rs1));
   dbg_printf("RBF[rs2] = %f \n", load_double(rs2));
-  if ((custom_isnan(load_double(rs1)) == 1) ||
-      (custom_isnan(load_double(rs2)) == 1)) {
-    printf("Invalid Operation\n");
-    RB[rd] = 0;
-  }
+  if (double_is_snan(load_double(rs1)) || double_is_snan(load_double(rs2)))
+    fp_pending |= FFLAG_NV;
   if (load_double(rs1) == load_double(rs2))
     RB[rd] = 1;
   else
     RB[rd] = 0;
   dbg_printf("Result = %d \n \n", RB[rd]);
+  SOFT_CHECK(X, "FEQ.D");
 }
 
 // Instruction FLE_D behavior method
 void ac_behavior(FLE_D) {
   dbg_printf("FLE.D r%d, r%d, r%d \n", rd, rs1, rs2);
+  SOFT_FP(X, sf::le<sf::f64>(FD(rs1), FD(rs2), soft_flags));
+  FP_FLAGS();
   dbg_printf("RBF[rs1] = %f \n", load_double(rs1));
   dbg_printf("RBF[rs2] = %f \n", load_double(rs2));
   if ((custom_isnan(load_double(rs1)) == 1) ||
       (custom_isnan(load_double(rs2)) == 1)) {
-    printf("Invalid Operation\n");
-    RB[rd] = 0;
+    fp_pending |= FFLAG_NV;
   }
   if (load_double(rs1) <= load_double(rs2))
     RB[rd] = 1;
   else
     RB[rd] = 0;
   dbg_printf("Result = %d \n \n", RB[rd]);
+  SOFT_CHECK(X, "FLE.D");
+}
+
+// Instruction FCLASS_D behavior method
+void ac_behavior(FCLASS_D) {
+  dbg_printf("FCLASS.D r%d, r%d \n", rd, rs1);
+  RB[rd] = fclass(RBF[rs1], 11, 52);
+  dbg_printf("Result = %#x \n \n", RB[rd]);
 }
 
 // Instruction FLT_D behavior method
 void ac_behavior(FLT_D) {
   dbg_printf("FLT.D r%d, r%d, r%d \n", rd, rs1, rs2);
+  SOFT_FP(X, sf::lt<sf::f64>(FD(rs1), FD(rs2), soft_flags));
+  FP_FLAGS();
   dbg_printf("RBF[rs1] = %f \n", load_double(rs1));
   dbg_printf("RBF[rs2] = %f \n", load_double(rs2));
   if ((custom_isnan(load_double(rs1)) == 1) ||
       (custom_isnan(load_double(rs2)) == 1)) {
-    printf("Invalid Operation\n");
-    RB[rd] = 0;
+    fp_pending |= FFLAG_NV;
   }
   if (load_double(rs1) < load_double(rs2))
     RB[rd] = 1;
   else
     RB[rd] = 0;
   dbg_printf("Result = %d \n \n", RB[rd]);
+  SOFT_CHECK(X, "FLT.D");
+}
+
+// Instruction C0/C1/C2 behavior methods: compressed instructions of
+// quadrants 0-2, expanded and run by rvc_execute()
+void ac_behavior(C0) { rvc_execute(cfunct3 << 13 | cbody << 2 | cop); }
+
+void ac_behavior(C1) { rvc_execute(cfunct3 << 13 | cbody << 2 | cop); }
+
+void ac_behavior(C2) { rvc_execute(cfunct3 << 13 | cbody << 2 | cop); }
+
+// Instruction SH1ADD behavior method
+void ac_behavior(SH1ADD) {
+  dbg_printf("SH1ADD r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(32);
+  RB[rd] = (RB[rs1] << 1) + RB[rs2];
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction SH2ADD behavior method
+void ac_behavior(SH2ADD) {
+  dbg_printf("SH2ADD r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(32);
+  RB[rd] = (RB[rs1] << 2) + RB[rs2];
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction SH3ADD behavior method
+void ac_behavior(SH3ADD) {
+  dbg_printf("SH3ADD r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(32);
+  RB[rd] = (RB[rs1] << 3) + RB[rs2];
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction ANDN behavior method
+void ac_behavior(ANDN) {
+  dbg_printf("ANDN r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(32);
+  RB[rd] = RB[rs1] & ~RB[rs2];
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction ORN behavior method
+void ac_behavior(ORN) {
+  dbg_printf("ORN r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(32);
+  RB[rd] = RB[rs1] | ~RB[rs2];
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction XNOR behavior method
+void ac_behavior(XNOR) {
+  dbg_printf("XNOR r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(32);
+  RB[rd] = ~(RB[rs1] ^ RB[rs2]);
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction MIN behavior method
+void ac_behavior(MIN) {
+  dbg_printf("MIN r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(32);
+  RB[rd] = std::min((int32_t)RB[rs1], (int32_t)RB[rs2]);
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction MINU behavior method
+void ac_behavior(MINU) {
+  dbg_printf("MINU r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(32);
+  RB[rd] = std::min((uint32_t)RB[rs1], (uint32_t)RB[rs2]);
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction MAX behavior method
+void ac_behavior(MAX) {
+  dbg_printf("MAX r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(32);
+  RB[rd] = std::max((int32_t)RB[rs1], (int32_t)RB[rs2]);
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction MAXU behavior method
+void ac_behavior(MAXU) {
+  dbg_printf("MAXU r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(32);
+  RB[rd] = std::max((uint32_t)RB[rs1], (uint32_t)RB[rs2]);
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction ROL behavior method
+void ac_behavior(ROL) {
+  dbg_printf("ROL r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(32);
+  RB[rd] = rotate_left(RB[rs1], RB[rs2]);
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction ROR behavior method
+void ac_behavior(ROR) {
+  dbg_printf("ROR r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(32);
+  RB[rd] = rotate_left(RB[rs1], -RB[rs2]);
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction RORI behavior method
+void ac_behavior(RORI) {
+  dbg_printf("RORI r%d, r%d, %d\n", rd, rs1, rs2);
+  XLEN_ONLY(32);
+  RB[rd] = rotate_left(RB[rs1], -rs2);
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction CLZ behavior method
+void ac_behavior(CLZ) {
+  dbg_printf("CLZ r%d, r%d\n", rd, rs1);
+  XLEN_ONLY(32);
+  RB[rd] = RB[rs1] ? __builtin_clz(RB[rs1]) : 32;
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction CTZ behavior method
+void ac_behavior(CTZ) {
+  dbg_printf("CTZ r%d, r%d\n", rd, rs1);
+  XLEN_ONLY(32);
+  RB[rd] = RB[rs1] ? __builtin_ctz(RB[rs1]) : 32;
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction CPOP behavior method
+void ac_behavior(CPOP) {
+  dbg_printf("CPOP r%d, r%d\n", rd, rs1);
+  XLEN_ONLY(32);
+  RB[rd] = __builtin_popcount(RB[rs1]);
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction SEXT.B behavior method
+void ac_behavior(SEXT_B) {
+  dbg_printf("SEXT.B r%d, r%d\n", rd, rs1);
+  XLEN_ONLY(32);
+  RB[rd] = (int8_t)RB[rs1];
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction SEXT.H behavior method
+void ac_behavior(SEXT_H) {
+  dbg_printf("SEXT.H r%d, r%d\n", rd, rs1);
+  XLEN_ONLY(32);
+  RB[rd] = (int16_t)RB[rs1];
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction ZEXT.H behavior method
+void ac_behavior(ZEXT_H) {
+  dbg_printf("ZEXT.H r%d, r%d\n", rd, rs1);
+  XLEN_ONLY(32);
+  RB[rd] = (uint16_t)RB[rs1];
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction ORC.B behavior method
+void ac_behavior(ORC_B) {
+  dbg_printf("ORC.B r%d, r%d\n", rd, rs1);
+  XLEN_ONLY(32);
+  // 0xFF in every byte that is not zero: the high bit of a byte is
+  // set by the byte itself or by the carry out of its low seven bits
+  uint32_t high = ((RB[rs1] & 0x7F7F7F7F) + 0x7F7F7F7F) | RB[rs1];
+  RB[rd] = ((high & 0x80808080) >> 7) * 0xFF;
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction REV8 behavior method
+void ac_behavior(REV8) {
+  dbg_printf("REV8 r%d, r%d\n", rd, rs1);
+  XLEN_ONLY(32);
+  RB[rd] = __builtin_bswap32(RB[rs1]);
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction BCLR behavior method
+void ac_behavior(BCLR) {
+  dbg_printf("BCLR r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(32);
+  RB[rd] = RB[rs1] & ~(1u << (RB[rs2] & 31));
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction BCLRI behavior method
+void ac_behavior(BCLRI) {
+  dbg_printf("BCLRI r%d, r%d, %d\n", rd, rs1, rs2);
+  XLEN_ONLY(32);
+  RB[rd] = RB[rs1] & ~(1u << rs2);
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction BEXT behavior method
+void ac_behavior(BEXT) {
+  dbg_printf("BEXT r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(32);
+  RB[rd] = (RB[rs1] >> (RB[rs2] & 31)) & 1;
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction BEXTI behavior method
+void ac_behavior(BEXTI) {
+  dbg_printf("BEXTI r%d, r%d, %d\n", rd, rs1, rs2);
+  XLEN_ONLY(32);
+  RB[rd] = (RB[rs1] >> rs2) & 1;
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction BINV behavior method
+void ac_behavior(BINV) {
+  dbg_printf("BINV r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(32);
+  RB[rd] = RB[rs1] ^ (1u << (RB[rs2] & 31));
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction BINVI behavior method
+void ac_behavior(BINVI) {
+  dbg_printf("BINVI r%d, r%d, %d\n", rd, rs1, rs2);
+  XLEN_ONLY(32);
+  RB[rd] = RB[rs1] ^ (1u << rs2);
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction BSET behavior method
+void ac_behavior(BSET) {
+  dbg_printf("BSET r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(32);
+  RB[rd] = RB[rs1] | (1u << (RB[rs2] & 31));
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction BSETI behavior method
+void ac_behavior(BSETI) {
+  dbg_printf("BSETI r%d, r%d, %d\n", rd, rs1, rs2);
+  XLEN_ONLY(32);
+  RB[rd] = RB[rs1] | (1u << rs2);
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction VSETVLI behavior method
+void ac_behavior(VSETVLI) {
+  dbg_printf("VSETVLI r%d, r%d, %#x\n", rd, rs1, vzimm);
+  rvv_setvl(rd, rs1, RB[rs1], vzimm);
+  dbg_printf("vl = %d\n\n", (uint32_t)vl);
+}
+
+// Instruction VSETIVLI behavior method
+void ac_behavior(VSETIVLI) {
+  dbg_printf("VSETIVLI r%d, %d, %#x\n", rd, rs1, vzimm);
+  rvv_setvl(rd, -1, rs1, vzimm);
+  dbg_printf("vl = %d\n\n", (uint32_t)vl);
+}
+
+// Instruction VSETVL behavior method
+void ac_behavior(VSETVL) {
+  dbg_printf("VSETVL r%d, r%d, r%d\n", vd, vs1, vs2);
+  rvv_setvl(vd, vs1, RB[vs1], RB[vs2]);
+  dbg_printf("vl = %d\n\n", (uint32_t)vl);
+}
+
+// Instruction VLE8.V behavior method
+void ac_behavior(VLE8_V) {
+  dbg_printf("VLE8.V v%d, (r%d)\n", vd, rs1);
+  rvv_memory(false, vd, RB[rs1], 1, 1, vm);
+}
+
+// Instruction VLE16.V behavior method
+void ac_behavior(VLE16_V) {
+  dbg_printf("VLE16.V v%d, (r%d)\n", vd, rs1);
+  rvv_memory(false, vd, RB[rs1], 2, 2, vm);
+}
+
+// Instruction VLE32.V behavior method
+void ac_behavior(VLE32_V) {
+  dbg_printf("VLE32.V v%d, (r%d)\n", vd, rs1);
+  rvv_memory(false, vd, RB[rs1], 4, 4, vm);
+}
+
+// Instruction VLSE8.V behavior method
+void ac_behavior(VLSE8_V) {
+  dbg_printf("VLSE8.V v%d, (r%d), r%d\n", vd, rs1, rs2);
+  rvv_memory(false, vd, RB[rs1], RB[rs2], 1, vm);
+}
+
+// Instruction VLSE16.V behavior method
+void ac_behavior(VLSE16_V) {
+  dbg_printf("VLSE16.V v%d, (r%d), r%d\n", vd, rs1, rs2);
+  rvv_memory(false, vd, RB[rs1], RB[rs2], 2, vm);
+}
+
+// Instruction VLSE32.V behavior method
+void ac_behavior(VLSE32_V) {
+  dbg_printf("VLSE32.V v%d, (r%d), r%d\n", vd, rs1, rs2);
+  rvv_memory(false, vd, RB[rs1], RB[rs2], 4, vm);
+}
+
+// Instruction VSE8.V behavior method
+void ac_behavior(VSE8_V) {
+  dbg_printf("VSE8.V v%d, (r%d)\n", vd, rs1);
+  rvv_memory(true, vd, RB[rs1], 1, 1, vm);
+}
+
+// Instruction VSE16.V behavior method
+void ac_behavior(VSE16_V) {
+  dbg_printf("VSE16.V v%d, (r%d)\n", vd, rs1);
+  rvv_memory(true, vd, RB[rs1], 2, 2, vm);
+}
+
+// Instruction VSE32.V behavior method
+void ac_behavior(VSE32_V) {
+  dbg_printf("VSE32.V v%d, (r%d)\n", vd, rs1);
+  rvv_memory(true, vd, RB[rs1], 4, 4, vm);
+}
+
+// Instruction VSSE8.V behavior method
+void ac_behavior(VSSE8_V) {
+  dbg_printf("VSSE8.V v%d, (r%d), r%d\n", vd, rs1, rs2);
+  rvv_memory(true, vd, RB[rs1], RB[rs2], 1, vm);
+}
+
+// Instruction VSSE16.V behavior method
+void ac_behavior(VSSE16_V) {
+  dbg_printf("VSSE16.V v%d, (r%d), r%d\n", vd, rs1, rs2);
+  rvv_memory(true, vd, RB[rs1], RB[rs2], 2, vm);
+}
+
+// Instruction VSSE32.V behavior method
+void ac_behavior(VSSE32_V) {
+  dbg_printf("VSSE32.V v%d, (r%d), r%d\n", vd, rs1, rs2);
+  rvv_memory(true, vd, RB[rs1], RB[rs2], 4, vm);
+}
+
+// Instruction OPIVV/OPFVV/OPMVV/OPIVI/OPIVX/OPFVF/OPMVX behavior methods:
+// vector arithmetic of each operand category, see rvv_execute()
+void ac_behavior(OPIVV) { rvv_execute(RVV_OPIVV, funct6, vm, vs2, vs1, vd); }
+
+void ac_behavior(OPFVV) { rvv_execute(RVV_OPFVV, funct6, vm, vs2, vs1, vd); }
+
+void ac_behavior(OPMVV) { rvv_execute(RVV_OPMVV, funct6, vm, vs2, vs1, vd); }
+
+void ac_behavior(OPIVI) { rvv_execute(RVV_OPIVI, funct6, vm, vs2, vs1, vd); }
+
+void ac_behavior(OPIVX) { rvv_execute(RVV_OPIVX, funct6, vm, vs2, vs1, vd); }
+
+void ac_behavior(OPFVF) { rvv_execute(RVV_OPFVF, funct6, vm, vs2, vs1, vd); }
+
+void ac_behavior(OPMVX) { rvv_execute(RVV_OPMVX, funct6, vm, vs2, vs1, vd); }
+
+// Zicbom: cbo.clean, cbo.flush and cbo.inval act on the block holding
+// x[rs1] in the coherence model, if there is one; memory never changes.
+void ac_behavior(CBO_CLEAN) {
+  dbg_printf("CBO.CLEAN (r%d)\n", rs1);
+  COHERENCE_CBO(RB[rs1] & ~(ac_word)(RISCV_CBO_SIZE - 1), true, false);
+}
+
+void ac_behavior(CBO_FLUSH) {
+  dbg_printf("CBO.FLUSH (r%d)\n", rs1);
+  COHERENCE_CBO(RB[rs1] & ~(ac_word)(RISCV_CBO_SIZE - 1), true, true);
+}
+
+void ac_behavior(CBO_INVAL) {
+  dbg_printf("CBO.INVAL (r%d)\n", rs1);
+  COHERENCE_CBO(RB[rs1] & ~(ac_word)(RISCV_CBO_SIZE - 1), false, true);
+}
+
+// Zicboz: cbo.zero clears the block holding x[rs1] as one store. In the
+// shared window that is one host memset; DM has no host pointer, there
+// it takes a doubleword write per 8 bytes.
+void ac_behavior(CBO_ZERO) {
+  ac_word block = RB[rs1] & ~(ac_word)(RISCV_CBO_SIZE - 1);
+  dbg_printf("CBO.ZERO (r%d) block %#x\n", rs1, (uint32_t)block);
+  MEM_WRITE_HOOK(block, RISCV_CBO_SIZE);
+  if (SHM_HIT(block) && SHM_HIT(block + RISCV_CBO_SIZE - 1)) {
+    memset(SHM_PTR(block), 0, RISCV_CBO_SIZE);
+    return;
+  }
+  for (unsigned i = 0; i < RISCV_CBO_SIZE; i += 8)
+    WRITE_DWORD(block + i, 0);
+}
+
+// RV64I, RV64M, RV64A, RV64F and RV64D. The *W forms compute on the low
+// 32 bits and sign-extend; on riscv.ac every one of them is illegal.
+
+// Instruction LWU behavior method
+void ac_behavior(LWU) {
+  int offset;
+  offset = (imm4 << 11) | (imm3 << 5) | (imm2 << 1) | imm1;
+  dbg_printf("LWU r%d, r%d, %d\n", rd, rs1, offset);
+  XLEN_ONLY(64);
+  int sign_ext;
+  sign_ext = sign_extend(offset, 12);
+  LOAD_ALIGN(RB[rs1] + sign_ext, 4);
+  MEM_READ_HOOK(RB[rs1] + sign_ext, 4);
+  RB[rd] = READ_WORD(RB[rs1] + sign_ext);
+  dbg_printf("Result = %#x\n\n", RB[rd]);
+}
+
+// Instruction LD behavior method
+void ac_behavior(LD) {
+  int offset;
+  offset = (imm4 << 11) | (imm3 << 5) | (imm2 << 1) | imm1;
+  dbg_printf("LD r%d, r%d, %d\n", rd, rs1, offset);
+  XLEN_ONLY(64);
+  int sign_ext;
+  sign_ext = sign_extend(offset, 12);
+  LOAD_ALIGN(RB[rs1] + sign_ext, 8);
+  MEM_READ_HOOK(RB[rs1] + sign_ext, 8);
+  RB[rd] = READ_DWORD(RB[rs1] + sign_ext);
+  dbg_printf("Result = %#llx\n\n", (unsigned long long)RB[rd]);
+}
+
+// Instruction SD behavior method
+void ac_behavior(SD) {
+  int imm;
+  imm = (imm4 << 11) | (imm3 << 5) | (imm2 << 1) | imm1;
+  dbg_printf("SD r%d, r%d, %d\n", rs1, rs2, imm);
+  XLEN_ONLY(64);
+  int sign_ext;
+  sign_ext = sign_extend(imm, 12);
+  STORE_ALIGN(RB[rs1] + sign_ext, 8);
+  MEM_WRITE_HOOK(RB[rs1] + sign_ext, 8);
+  WRITE_DWORD(RB[rs1] + sign_ext, RB[rs2]);
+}
+
+// Instruction ADDIW behavior method
+void ac_behavior(ADDIW) {
+  int imm;
+  imm = (imm4 << 11) | (imm3 << 5) | (imm2 << 1) | imm1;
+  dbg_printf("ADDIW r%d, r%d, %d\n", rd, rs1, imm);
+  XLEN_ONLY(64);
+  RB[rd] = (int32_t)(RB[rs1] + sign_extend(imm, 12));
+  dbg_printf("Result = %d\n\n", (int32_t)RB[rd]);
+}
+
+// Instruction SLLIW behavior method
+void ac_behavior(SLLIW) {
+  dbg_printf("SLLIW r%d, r%d, %d\n", rd, rs1, rs2);
+  XLEN_ONLY(64);
+  RB[rd] = (int32_t)((uint32_t)RB[rs1] << rs2);
+  dbg_printf("Result = %d\n\n", (int32_t)RB[rd]);
+}
+
+// Instruction SRLIW behavior method
+void ac_behavior(SRLIW) {
+  dbg_printf("SRLIW r%d, r%d, %d\n", rd, rs1, rs2);
+  XLEN_ONLY(64);
+  RB[rd] = (int32_t)((uint32_t)RB[rs1] >> rs2);
+  dbg_printf("Result = %d\n\n", (int32_t)RB[rd]);
+}
+
+// Instruction SRAIW behavior method
+void ac_behavior(SRAIW) {
+  dbg_printf("SRAIW r%d, r%d, %d\n", rd, rs1, rs2);
+  XLEN_ONLY(64);
+  RB[rd] = (int32_t)RB[rs1] >> rs2;
+  dbg_printf("Result = %d\n\n", (int32_t)RB[rd]);
+}
+
+// Instruction ADDW behavior method
+void ac_behavior(ADDW) {
+  dbg_printf("ADDW r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(64);
+  RB[rd] = (int32_t)(RB[rs1] + RB[rs2]);
+  dbg_printf("Result = %d\n\n", (int32_t)RB[rd]);
+}
+
+// Instruction SUBW behavior method
+void ac_behavior(SUBW) {
+  dbg_printf("SUBW r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(64);
+  RB[rd] = (int32_t)(RB[rs1] - RB[rs2]);
+  dbg_printf("Result = %d\n\n", (int32_t)RB[rd]);
+}
+
+// Instruction SLLW behavior method
+void ac_behavior(SLLW) {
+  dbg_printf("SLLW r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(64);
+  RB[rd] = (int32_t)((uint32_t)RB[rs1] << (RB[rs2] & 31));
+  dbg_printf("Result = %d\n\n", (int32_t)RB[rd]);
+}
+
+// Instruction SRLW behavior method
+void ac_behavior(SRLW) {
+  dbg_printf("SRLW r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(64);
+  RB[rd] = (int32_t)((uint32_t)RB[rs1] >> (RB[rs2] & 31));
+  dbg_printf("Result = %d\n\n", (int32_t)RB[rd]);
+}
+
+// Instruction SRAW behavior method
+void ac_behavior(SRAW) {
+  dbg_printf("SRAW r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(64);
+  RB[rd] = (int32_t)RB[rs1] >> (RB[rs2] & 31);
+  dbg_printf("Result = %d\n\n", (int32_t)RB[rd]);
+}
+
+// Instruction MULW behavior method
+void ac_behavior(MULW) {
+  dbg_printf("MULW r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(64);
+  RB[rd] = (int32_t)((uint32_t)RB[rs1] * (uint32_t)RB[rs2]);
+  dbg_printf("Result = %d\n\n", (int32_t)RB[rd]);
+}
+
+// Instruction DIVW behavior method
+void ac_behavior(DIVW) {
+  dbg_printf("DIVW r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(64);
+  int32_t dividend = RB[rs1], divisor = RB[rs2];
+  if (divisor == 0)
+    RB[rd] = -1;
+  else if (divisor == -1)
+    RB[rd] = (int32_t)-(uint32_t)dividend;
+  else
+    RB[rd] = dividend / divisor;
+  dbg_printf("Result = %d\n\n", (int32_t)RB[rd]);
+}
+
+// Instruction DIVUW behavior method
+void ac_behavior(DIVUW) {
+  dbg_printf("DIVUW r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(64);
+  uint32_t dividend = RB[rs1], divisor = RB[rs2];
+  if (divisor == 0)
+    RB[rd] = -1;
+  else
+    RB[rd] = (int32_t)(dividend / divisor);
+  dbg_printf("Result = %d\n\n", (int32_t)RB[rd]);
+}
+
+// Instruction REMW behavior method
+void ac_behavior(REMW) {
+  dbg_printf("REMW r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(64);
+  int32_t dividend = RB[rs1], divisor = RB[rs2];
+  if (divisor == 0)
+    RB[rd] = dividend;
+  else if (divisor == -1)
+    RB[rd] = 0;
+  else
+    RB[rd] = dividend % divisor;
+  dbg_printf("Result = %d\n\n", (int32_t)RB[rd]);
+}
+
+// Instruction REMUW behavior method
+void ac_behavior(REMUW) {
+  dbg_printf("REMUW r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(64);
+  uint32_t dividend = RB[rs1], divisor = RB[rs2];
+  if (divisor == 0)
+    RB[rd] = (int32_t)dividend;
+  else
+    RB[rd] = (int32_t)(dividend % divisor);
+  dbg_printf("Result = %d\n\n", (int32_t)RB[rd]);
+}
+
+// Instruction LR.D behavior method
+void ac_behavior(LR_D) {
+  XLEN_ONLY(64);
+  LOAD_ALIGN(RB[rs1], 8);
+  HPM_COUNT(HPM_AMOS);
+  MEM_READ_HOOK(RB[rs1], 8);
+  lr_addr = RB[rs1];
+  lr_valid = true;
+  if (SHM_HIT(RB[rs1]))
+    lr_value = __atomic_load_n((uint64_t *)SHM_PTR(RB[rs1]), __ATOMIC_SEQ_CST);
+  else
+    lr_value = READ_DWORD(RB[rs1]);
+  RB[rd] = lr_value;
+}
+
+// Instruction SC.D behavior method
+void ac_behavior(SC_D) {
+  XLEN_ONLY(64);
+  STORE_ALIGN(RB[rs1], 8);
+  HPM_COUNT(HPM_AMOS);
+  bool reserved = lr_valid && lr_addr == RB[rs1];
+  MEM_WRITE_HOOK(RB[rs1], 8);
+  lr_valid = false;
+  if (SHM_HIT(RB[rs1])) {
+    uint64_t expected = lr_value;
+    bool ok = reserved &&
+              __atomic_compare_exchange_n((uint64_t *)SHM_PTR(RB[rs1]),
+                                          &expected, (uint64_t)RB[rs2], false,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+    RB[rd] = ok ? 0 : 1;
+    return;
+  }
+  if (!reserved || (uint64_t)READ_DWORD(RB[rs1]) != lr_value) {
+    RB[rd] = 1;
+    return;
+  }
+  WRITE_DWORD(RB[rs1], RB[rs2]);
+  RB[rd] = 0;
+}
+
+// Instruction AMOSWAP.D behavior method
+void ac_behavior(AMOSWAP_D) {
+  dbg_printf("AMOSWAP.D r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(64);
+  amo(RISCV_AMO_SWAP, true, rd, RB[rs1], RB[rs2]);
+}
+
+// Instruction AMOADD.D behavior method
+void ac_behavior(AMOADD_D) {
+  dbg_printf("AMOADD.D r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(64);
+  amo(RISCV_AMO_ADD, true, rd, RB[rs1], RB[rs2]);
+}
+
+// Instruction AMOXOR.D behavior method
+void ac_behavior(AMOXOR_D) {
+  dbg_printf("AMOXOR.D r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(64);
+  amo(RISCV_AMO_XOR, true, rd, RB[rs1], RB[rs2]);
+}
+
+// Instruction AMOAND.D behavior method
+void ac_behavior(AMOAND_D) {
+  dbg_printf("AMOAND.D r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(64);
+  amo(RISCV_AMO_AND, true, rd, RB[rs1], RB[rs2]);
+}
+
+// Instruction AMOOR.D behavior method
+void ac_behavior(AMOOR_D) {
+  dbg_printf("AMOOR.D r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(64);
+  amo(RISCV_AMO_OR, true, rd, RB[rs1], RB[rs2]);
+}
+
+// Instruction AMOMIN.D behavior method
+void ac_behavior(AMOMIN_D) {
+  dbg_printf("AMOMIN.D r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(64);
+  amo(RISCV_AMO_MIN, true, rd, RB[rs1], RB[rs2]);
+}
+
+// Instruction AMOMAX.D behavior method
+void ac_behavior(AMOMAX_D) {
+  dbg_printf("AMOMAX.D r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(64);
+  amo(RISCV_AMO_MAX, true, rd, RB[rs1], RB[rs2]);
+}
+
+// Instruction AMOMINU.D behavior method
+void ac_behavior(AMOMINU_D) {
+  dbg_printf("AMOMINU.D r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(64);
+  amo(RISCV_AMO_MINU, true, rd, RB[rs1], RB[rs2]);
+}
+
+// Instruction AMOMAXU.D behavior method
+void ac_behavior(AMOMAXU_D) {
+  dbg_printf("AMOMAXU.D r%d, r%d, r%d\n", rd, rs1, rs2);
+  XLEN_ONLY(64);
+  amo(RISCV_AMO_MAXU, true, rd, RB[rs1], RB[rs2]);
+}
+
+// Instruction FCVT.L.S behavior method
+void ac_behavior(FCVT_L_S) {
+  dbg_printf("FCVT.L.S r%d, r%d\n", rd, rs1);
+  XLEN_ONLY(64);
+  FP_RM_LEGAL(funct3);
+  SOFT_FP(L, sf::to_int<sf::f32>(FS(rs1), FP_MODE(funct3), true, soft_flags,
+                                 64));
+  RB[rd] = fcvt_long(load_float(rs1), FP_MODE(funct3), true, fp_pending);
+  SOFT_CHECK(L, "FCVT.L.S");
+}
+
+// Instruction FCVT.LU.S behavior method
+void ac_behavior(FCVT_LU_S) {
+  dbg_printf("FCVT.LU.S r%d, r%d\n", rd, rs1);
+  XLEN_ONLY(64);
+  FP_RM_LEGAL(funct3);
+  SOFT_FP(L, sf::to_int<sf::f32>(FS(rs1), FP_MODE(funct3), false, soft_flags,
+                                 64));
+  RB[rd] = fcvt_long(load_float(rs1), FP_MODE(funct3), false, fp_pending);
+  SOFT_CHECK(L, "FCVT.LU.S");
+}
+
+// Instruction FCVT.S.L behavior method
+void ac_behavior(FCVT_S_L) {
+  dbg_printf("FCVT.S.L r%d, r%d\n", rd, rs1);
+  XLEN_ONLY(64);
+  SOFT_FP_RM(S, funct3,
+             sf::from_int<sf::f32>((int64_t)RB[rs1], FP_MODE(funct3),
+                                   soft_flags));
+  FP_ROUND(funct3);
+  save_float((float)(int64_t)RB[rs1], rd);
+  SOFT_CHECK(S, "FCVT.S.L");
+}
+
+// Instruction FCVT.S.LU behavior method
+void ac_behavior(FCVT_S_LU) {
+  dbg_printf("FCVT.S.LU r%d, r%d\n", rd, rs1);
+  XLEN_ONLY(64);
+  SOFT_FP_RM(S, funct3,
+             sf::from_uint<sf::f32>((uint64_t)RB[rs1], FP_MODE(funct3),
+                                    soft_flags));
+  FP_ROUND(funct3);
+  save_float((float)(uint64_t)RB[rs1], rd);
+  SOFT_CHECK(S, "FCVT.S.LU");
+}
+
+// Instruction FCVT.L.D behavior method
+void ac_behavior(FCVT_L_D) {
+  dbg_printf("FCVT.L.D r%d, r%d\n", rd, rs1);
+  XLEN_ONLY(64);
+  FP_RM_LEGAL(funct3);
+  SOFT_FP(L, sf::to_int<sf::f64>(FD(rs1), FP_MODE(funct3), true, soft_flags,
+                                 64));
+  RB[rd] = fcvt_long(load_double(rs1), FP_MODE(funct3), true, fp_pending);
+  SOFT_CHECK(L, "FCVT.L.D");
+}
+
+// Instruction FCVT.LU.D behavior method
+void ac_behavior(FCVT_LU_D) {
+  dbg_printf("FCVT.LU.D r%d, r%d\n", rd, rs1);
+  XLEN_ONLY(64);
+  FP_RM_LEGAL(funct3);
+  SOFT_FP(L, sf::to_int<sf::f64>(FD(rs1), FP_MODE(funct3), false, soft_flags,
+                                 64));
+  RB[rd] = fcvt_long(load_double(rs1), FP_MODE(funct3), false, fp_pending);
+  SOFT_CHECK(L, "FCVT.LU.D");
+}
+
+// Instruction FCVT.D.L behavior method
+void ac_behavior(FCVT_D_L) {
+  dbg_printf("FCVT.D.L r%d, r%d\n", rd, rs1);
+  XLEN_ONLY(64);
+  SOFT_FP_RM(D, funct3,
+             sf::from_int<sf::f64>((int64_t)RB[rs1], FP_MODE(funct3),
+                                   soft_flags));
+  FP_ROUND(funct3);
+  save_double((double)(int64_t)RB[rs1], rd);
+  SOFT_CHECK(D, "FCVT.D.L");
+}
+
+// Instruction FCVT.D.LU behavior method
+void ac_behavior(FCVT_D_LU) {
+  dbg_printf("FCVT.D.LU r%d, r%d\n", rd, rs1);
+  XLEN_ONLY(64);
+  SOFT_FP_RM(D, funct3,
+             sf::from_uint<sf::f64>((uint64_t)RB[rs1], FP_MODE(funct3),
+                                    soft_flags));
+  FP_ROUND(funct3);
+  save_double((double)(uint64_t)RB[rs1], rd);
+  SOFT_CHECK(D, "FCVT.D.LU");
+}
+
+// Instruction FMV_X_D behavior method
+void ac_behavior(FMV_X_D) {
+  dbg_printf("FMV.X.D r%d, r%d\n", rd, rs1);
+  XLEN_ONLY(64);
+  RB[rd] = RBF[rs1];
+}
+
+// Instruction FMV_D_X behavior method
+void ac_behavior(FMV_D_X) {
+  dbg_printf("FMV.D.X r%d, r%d\n", rd, rs1);
+  XLEN_ONLY(64);
+  RBF[rd] = RB[rs1];
 }
@@ -10,18 +10,30 @@
 *************************************************/
 
 #include "riscv_syscall.H"
+#include "riscv_forkserver.H"
+#include "riscv_hle.H"
+#include "riscv_layout.H"
+#include "riscv_shm.H"
 
 // 'using namespace' statement to allow access to all
 // riscv-specific datatypes
 using namespace riscv_parms;
 unsigned procNumber = 0;
+static std::vector<riscv_syscall *> local_harts;   // indexed by procNumber
+
+riscv_syscall *riscv_syscall::local(unsigned n)
+{
+  return n < local_harts.size() ? local_harts[n] : 0;
+}
 
 void riscv_syscall::get_buffer(int argn, unsigned char* buf, unsigned int size)
 {
   unsigned int addr = RB[10+argn];
 
+  riscv_shm &shm = riscv_shm::instance();
+
   for (unsigned int i = 0; i<size; i++, addr++) {
-    buf[i] = DM.read_byte(addr);
+    buf[i] = shm.hit(addr) ? *shm.host(addr) : DM.read_byte(addr);
   }
 }
 
@@ -29,8 +41,13 @@ void riscv_syscall::set_buffer(int argn, unsigned char* buf, unsigned int size)
 {
   unsigned int addr = RB[10+argn];
 
+  riscv_shm &shm = riscv_shm::instance();
+
   for (unsigned int i = 0; i<size; i++, addr++) {
-    DM.write_byte(addr, buf[i]);
+    if (shm.hit(addr))
+      *shm.host(addr) = buf[i];
+    else
+      DM.write_byte(addr, buf[i]);
   }
 }
 
@@ -38,8 +55,13 @@ void riscv_syscall::set_buffer_noinvert(int argn, unsigned char* buf, unsigned i
 {
   unsigned int addr = RB[10+argn];
 
-  for (unsigned int i = 0; i<size; i+=4, addr+=4) {
-    DM.write(addr, *(unsigned int *) &buf[i]);
+  riscv_shm &shm = riscv_shm::instance();
+
+  for (unsigned int i = 0; i<size; i+=sizeof(ac_word), addr+=sizeof(ac_word)) {
+    if (shm.hit(addr))
+      memcpy(shm.host(addr), &buf[i], sizeof(ac_word));
+    else
+      DM.write(addr, *(ac_word *) &buf[i]);
   }
 }
 
@@ -55,6 +77,7 @@ void riscv_syscall::set_int(int argn, int val)
 
 void riscv_syscall::return_from_syscall()
 {
+  syscalls++;
   ac_pc = RB[1];
 }
 
@@ -62,10 +85,36 @@ void riscv_syscall::set_prog_args(int argc, char **argv)
 {
   int i, j, base;
 
-  unsigned int ac_argv[30];
+  ac_word ac_argv[30];        // XLEN-wide pointers
   char ac_argstr[512];
 
-  base = AC_RAM_END - 512 - procNumber * 64 * 1024;
+  if (procNumber == 0 && argc > 0) {
+    riscv_elf_path() = argv[0];
+    riscv_forksrv_init();
+    riscv_hle::instance().init();
+  }
+
+  // Fork the other simulator processes before placing this hart
+  riscv_shm::instance().start(DM, AC_RAM_END);
+  int hart = riscv_shm::instance().hart_base() + procNumber;
+
+  riscv_hart_layout layout = riscv_layout(hart, AC_RAM_END);
+
+  // The frames grow down from AC_RAM_END; the lowest one must stay above
+  // the program image, where brk starts the heap
+  uint32_t image_end = 0;
+  riscv_elf_lookup("_end", image_end);
+  uint64_t frame = (uint64_t)AC_RAM_END - riscv_layout(0, AC_RAM_END).tp;
+  if (frame * (hart + 1) > (uint64_t)AC_RAM_END - image_end) {
+    fprintf(stderr, "Loader: hart %d frame (%llu bytes each) does not fit "
+            "between the program end %#x and the RAM end %#llx; lower "
+            "RISCV_STACK_SIZE or the hart count\n", hart,
+            (unsigned long long)frame, image_end,
+            (unsigned long long)AC_RAM_END);
+    exit(EXIT_FAILURE);
+  }
+
+  base = layout.args;
   for (i=0, j=0; i<argc; i++) {
     int len = strlen(argv[i]) + 1;
     ac_argv[i] = base + j;
@@ -77,8 +126,8 @@ void riscv_syscall::set_prog_args(int argc, char **argv)
   set_buffer(0, (unsigned char*) ac_argstr, 512);   //$25 = $29(sp) - 4 (set_buffer adds 4)
 
 
-  RB[10] = base - 120;
-  set_buffer_noinvert(0, (unsigned char*) ac_argv, 120);
+  RB[10] = base - sizeof(ac_argv);
+  set_buffer_noinvert(0, (unsigned char*) ac_argv, sizeof(ac_argv));
 
   //RB[4] = AC_RAM_END-512-128;
 
@@ -86,7 +135,19 @@ void riscv_syscall::set_prog_args(int argc, char **argv)
   RB[10] = argc;
 
   //Set %o1 to the string pointers
-  RB[11] = base - 120;
+  RB[11] = base - sizeof(ac_argv);
+
+  //Private stack and TLS block of this hart, crt.S fills the TLS block
+  RB[2] = layout.sp;
+  RB[4] = layout.tp;
+  local_harts.push_back(this);
+
+  uint32_t tls_start, tls_end;
+  if (riscv_elf_lookup("_tls_start", tls_start) &&
+      riscv_elf_lookup("_tls_end", tls_end) &&
+      tls_end - tls_start > layout.tls_size)
+    fprintf(stderr, "Loader: TLS image (%u bytes) exceeds RISCV_TLS_SIZE (%u bytes)\n",
+            tls_end - tls_start, layout.tls_size);
 
   procNumber ++;
 }
@@ -0,0 +1,65 @@
+/**
+ * @file      clint-harts.c
+ *
+ * @version   1.0
+ * @date      October 2026
+ * @brief     CLINT register test for two or more harts (RISCV_PROCS=2,
+ *            or a two-core simulator). Every hart writes its own msip
+ *            and both halves of its mtimecmp with 4-byte stores, reads
+ *            them back and checks mip.MSIP. Odd harts catch a 4-byte
+ *            msip slot being treated as half of an 8-byte register.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include "../rv_hal/get_id.h"
+
+#define CLINT_BASE 0x30000000
+#define MSIP(hart) ((volatile uint32_t *)(CLINT_BASE + 4 * (hart)))
+#define MTIMECMP_LO(hart) \
+  ((volatile uint32_t *)(CLINT_BASE + 0x4000 + 8 * (hart)))
+#define MTIMECMP_HI(hart) \
+  ((volatile uint32_t *)(CLINT_BASE + 0x4000 + 8 * (hart) + 4))
+
+#define MIP_MSIP (1u << 3)
+
+static inline uint32_t read_mip(void) {
+  uint32_t mip;
+  asm volatile("csrr %0, mip" : "=r"(mip));
+  return mip;
+}
+
+static unsigned check(int hart, const char *what, uint32_t got,
+                      uint32_t expected) {
+  if (got == expected)
+    return 0;
+  printf("hart %d: FAIL %s: %#x, expected %#x\n", hart, what,
+         (unsigned)got, (unsigned)expected);
+  return 1;
+}
+
+int main(void) {
+  int hart = get_id();
+  unsigned failed = 0;
+  uint32_t lo = 0x89ABCDEF - hart, hi = 0x01234567 + hart;
+
+  *MSIP(hart) = 1;
+  failed += check(hart, "msip set", *MSIP(hart), 1);
+  failed += check(hart, "mip.MSIP set", read_mip() & MIP_MSIP, MIP_MSIP);
+  *MSIP(hart) = 0;
+  failed += check(hart, "msip clear", *MSIP(hart), 0);
+  failed += check(hart, "mip.MSIP clear", read_mip() & MIP_MSIP, 0);
+
+  /* The usual RV32 sequence, so mtimecmp never drops below both halves */
+  *MTIMECMP_LO(hart) = 0xFFFFFFFF;
+  *MTIMECMP_HI(hart) = hi;
+  *MTIMECMP_LO(hart) = lo;
+  failed += check(hart, "mtimecmp low", *MTIMECMP_LO(hart), lo);
+  failed += check(hart, "mtimecmp high", *MTIMECMP_HI(hart), hi);
+
+  *MTIMECMP_LO(hart) = 0xFFFFFFFF;
+  *MTIMECMP_HI(hart) = 0xFFFFFFFF;
+
+  printf("clint-harts: hart %d, %u checks failed\n", hart, failed);
+  return failed != 0;
+}
@@ -0,0 +1,122 @@
+/**
+ * @file      fcvt-bench.c
+ *
+ * @version   1.0
+ * @date      October 2026
+ * @brief     FCVT.W[U].S/D microbenchmark. First checks the saturated
+ *            results and NV/NX flags the spec mandates on edge cases,
+ *            then runs ITERATIONS rounds of conversions in every static
+ *            rounding mode. Time the simulator on it (or compare the
+ *            simulation speed it prints) before and after a change to
+ *            the conversion behaviors.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifndef ITERATIONS
+#define ITERATIONS 200000
+#endif
+
+#define NV 0x10
+#define NX 0x01
+
+/* Read and clear fflags */
+static inline unsigned take_flags(void) {
+  unsigned flags;
+  asm volatile("fsflags %0, zero" : "=r"(flags));
+  return flags;
+}
+
+#define CVT_D(name, op, rm)                                           \
+  static inline uint32_t name(double x) {                             \
+    uint32_t r;                                                       \
+    asm volatile(op " %0, %1, " rm : "=r"(r) : "f"(x));              \
+    return r;                                                         \
+  }
+#define CVT_S(name, op, rm)                                           \
+  static inline uint32_t name(float x) {                              \
+    uint32_t r;                                                       \
+    asm volatile(op " %0, %1, " rm : "=r"(r) : "f"(x));              \
+    return r;                                                         \
+  }
+
+CVT_D(w_d_rne, "fcvt.w.d", "rne")
+CVT_D(w_d_rtz, "fcvt.w.d", "rtz")
+CVT_D(w_d_rdn, "fcvt.w.d", "rdn")
+CVT_D(w_d_rup, "fcvt.w.d", "rup")
+CVT_D(w_d_rmm, "fcvt.w.d", "rmm")
+CVT_D(wu_d_rne, "fcvt.wu.d", "rne")
+CVT_D(wu_d_rtz, "fcvt.wu.d", "rtz")
+CVT_S(w_s_rne, "fcvt.w.s", "rne")
+CVT_S(w_s_rtz, "fcvt.w.s", "rtz")
+CVT_S(w_s_rdn, "fcvt.w.s", "rdn")
+CVT_S(w_s_rup, "fcvt.w.s", "rup")
+CVT_S(wu_s_rtz, "fcvt.wu.s", "rtz")
+
+struct check {
+  const char *what;
+  uint32_t (*cvt)(double);
+  double x;
+  uint32_t result;
+  unsigned flags;
+};
+
+static const struct check checks[] = {
+  {"w.d rne 2.5", w_d_rne, 2.5, 2, NX},
+  {"w.d rne 3.5", w_d_rne, 3.5, 4, NX},
+  {"w.d rne -2.5", w_d_rne, -2.5, (uint32_t)-2, NX},
+  {"w.d rmm 2.5", w_d_rmm, 2.5, 3, NX},
+  {"w.d rmm -2.5", w_d_rmm, -2.5, (uint32_t)-3, NX},
+  {"w.d rdn -0.5", w_d_rdn, -0.5, (uint32_t)-1, NX},
+  {"w.d rup 0.5", w_d_rup, 0.5, 1, NX},
+  {"w.d rtz -7.0", w_d_rtz, -7.0, (uint32_t)-7, 0},
+  {"w.d rtz 2^31", w_d_rtz, 2147483648.0, 0x7FFFFFFF, NV},
+  {"w.d rtz -2^31-0.5", w_d_rtz, -2147483648.5, 0x80000000, NX},
+  {"w.d rtz -2^31-1", w_d_rtz, -2147483649.0, 0x80000000, NV},
+  {"w.d rne 2^31-0.5", w_d_rne, 2147483647.5, 0x7FFFFFFF, NV},
+  {"w.d rtz inf", w_d_rtz, __builtin_inf(), 0x7FFFFFFF, NV},
+  {"w.d rtz -inf", w_d_rtz, -__builtin_inf(), 0x80000000, NV},
+  {"w.d rtz nan", w_d_rtz, __builtin_nan(""), 0x7FFFFFFF, NV},
+  {"w.d rtz -nan", w_d_rtz, -__builtin_nan(""), 0x7FFFFFFF, NV},
+  {"wu.d rtz -0.5", wu_d_rtz, -0.5, 0, NX},
+  {"wu.d rtz -1.0", wu_d_rtz, -1.0, 0, NV},
+  {"wu.d rne 2^32-0.5", wu_d_rne, 4294967295.5, 0xFFFFFFFF, NV},
+  {"wu.d rtz 2^32-0.5", wu_d_rtz, 4294967295.5, 0xFFFFFFFF, NX},
+  {"wu.d rtz nan", wu_d_rtz, __builtin_nan(""), 0xFFFFFFFF, NV},
+};
+
+int main(void) {
+  unsigned i, failed = 0;
+  uint32_t sum = 0;
+
+  take_flags();
+  for (i = 0; i < sizeof(checks) / sizeof(checks[0]); i++) {
+    uint32_t r = checks[i].cvt(checks[i].x);
+    unsigned flags = take_flags();
+    if (r != checks[i].result || flags != checks[i].flags) {
+      printf("FAIL %s: %#x flags %#x, expected %#x flags %#x\n",
+             checks[i].what, (unsigned)r, flags,
+             (unsigned)checks[i].result, checks[i].flags);
+      failed++;
+    }
+  }
+  if (wu_s_rtz(-1.0f) != 0 || w_s_rtz(3e9f) != 0x7FFFFFFF ||
+      (take_flags() & NV) == 0) {
+    printf("FAIL single precision saturation\n");
+    failed++;
+  }
+  take_flags();
+
+  for (i = 0; i < ITERATIONS; i++) {
+    double d = (double)(int)(i * 2654435761u) / 4096.0;
+    float s = (float)d;
+    sum += w_d_rne(d) + w_d_rtz(d) + w_d_rdn(d) + w_d_rup(d) + w_d_rmm(d);
+    sum += wu_d_rtz(d) + wu_d_rne(d * d);
+    sum += w_s_rne(s) + w_s_rtz(s) + w_s_rdn(s) + w_s_rup(s) + wu_s_rtz(s);
+  }
+
+  printf("fcvt-bench: %u conversions, checksum %#x, %u checks failed\n",
+         ITERATIONS * 12, (unsigned)sum, failed);
+  return failed != 0;
+}